@@ -0,0 +1,181 @@
+//
+// Created by 吨吨 on 2026/10/19.
+//
+#include "acmatch.h"
+#include <stdlib.h>
+#include <string.h>
+
+static unsigned char foldLower(unsigned char c)
+{
+    return (c >= 'A' && c <= 'Z') ? (unsigned char)(c + 32) : c;
+}
+
+/* * 构建 Aho-Corasick 自动机
+ * 1.统计模式中出现过的字节，生成字节等价类
+ * 2.把所有模式插入字典树，转移表中 -1 表示暂时没有转移
+ * 3.按层次遍历计算失败链接，同时把缺失的转移补成失败链接上的转移，得到完整的 DFA
+ *
+ * @param ac 自动机
+ * @param patterns 模式串数组
+ * @param numPatterns 模式数量
+ * @param icase 是否忽略大小写
+ * @return 0 成功，-1 失败
+ */
+int acBuild(struct AhoCorasick *ac, char **patterns, int numPatterns, int icase)
+{
+    memset(ac, 0, sizeof(*ac));
+    ac->icase = icase;
+
+    size_t total = 0;
+    int numClasses = 1;
+    for (int i = 0; i < numPatterns; i++)
+    {
+        for (const unsigned char *p = (const unsigned char*)patterns[i]; *p != '\0'; p++)
+        {
+            unsigned char c = icase ? foldLower(*p) : *p;
+            if (ac->classOf[c] == 0)
+            {
+                ac->classOf[c] = (unsigned char)numClasses++;
+                if (icase && c >= 'a' && c <= 'z') ac->classOf[c - 32] = ac->classOf[c];
+            }
+            total++;
+        }
+    }
+    ac->numClasses = numClasses;
+
+    size_t maxStates = total + 1;
+    ac->next = malloc(sizeof(int) * maxStates * (size_t)numClasses);
+    ac->fail = calloc(maxStates, sizeof(int));
+    ac->output = malloc(sizeof(int) * maxStates);
+    ac->outLink = malloc(sizeof(int) * maxStates);
+    ac->patterns = calloc((size_t)numPatterns + 1, sizeof(char*));
+    ac->patternLens = calloc((size_t)numPatterns + 1, sizeof(size_t));
+    int *queue = malloc(sizeof(int) * maxStates);
+    if (!ac->next || !ac->fail || !ac->output || !ac->outLink || !ac->patterns || !ac->patternLens || !queue)
+    {
+        free(queue);
+        acFree(ac);
+        return -1;
+    }
+    memset(ac->next, 0xff, sizeof(int) * maxStates * (size_t)numClasses);
+    memset(ac->output, 0xff, sizeof(int) * maxStates);
+    ac->numStates = 1;
+
+    for (int i = 0; i < numPatterns; i++)
+    {
+        ac->patterns[i] = strdup(patterns[i]);
+        ac->patternLens[i] = strlen(patterns[i]);
+        ac->numPatterns++;
+        if (ac->patternLens[i] == 0) continue;
+
+        int state = 0;
+        for (const unsigned char *p = (const unsigned char*)patterns[i]; *p != '\0'; p++)
+        {
+            int *slot = &ac->next[state * numClasses + ac->classOf[*p]];
+            if (*slot < 0) *slot = ac->numStates++;
+            state = *slot;
+        }
+        if (ac->output[state] < 0) ac->output[state] = i; // 重复的模式只记第一个
+    }
+
+    // 根节点：没有转移的字节留在根节点
+    int head = 0, tail = 0;
+    ac->outLink[0] = -1;
+    for (int c = 0; c < numClasses; c++)
+    {
+        int t = ac->next[c];
+        if (t < 0)
+        {
+            ac->next[c] = 0;
+        }
+        else
+        {
+            ac->fail[t] = 0;
+            queue[tail++] = t;
+        }
+    }
+
+    while (head < tail)
+    {
+        int s = queue[head++];
+        ac->outLink[s] = ac->output[s] >= 0 ? s : ac->outLink[ac->fail[s]];
+        for (int c = 0; c < numClasses; c++)
+        {
+            int *slot = &ac->next[s * numClasses + c];
+            int viaFail = ac->next[ac->fail[s] * numClasses + c];
+            if (*slot < 0)
+            {
+                *slot = viaFail;
+            }
+            else
+            {
+                ac->fail[*slot] = viaFail;
+                queue[tail++] = *slot;
+            }
+        }
+    }
+    free(queue);
+
+    // 字典树的节点数通常远小于模式总长度，收缩转移表
+    int *shrunk = realloc(ac->next, sizeof(int) * (size_t)ac->numStates * (size_t)numClasses);
+    if (shrunk) ac->next = shrunk;
+    return 0;
+}
+
+void acFree(struct AhoCorasick *ac)
+{
+    if (ac->patterns)
+    {
+        for (int i = 0; i < ac->numPatterns; i++) free(ac->patterns[i]);
+    }
+    free(ac->patterns);
+    free(ac->patternLens);
+    free(ac->next);
+    free(ac->fail);
+    free(ac->output);
+    free(ac->outLink);
+    memset(ac, 0, sizeof(*ac));
+}
+
+/* * 从 text[*pos] 开始扫描，直到某个位置有模式结束
+ * 扫描可以分多次进行，state 和 pos 保存了上一次停下的位置
+ *
+ * @param ac 自动机
+ * @param text 文本
+ * @param len 文本长度
+ * @param state 输入输出：自动机当前状态，从头开始时为 0
+ * @param pos 输入输出：下一个要读取的字节
+ * @param hits 输出：在同一位置结束的所有命中
+ * @param maxHits hits 的容量
+ * @return 命中数量，0 表示扫描到了文本末尾
+ */
+int acScan(const struct AhoCorasick *ac, const char *text, size_t len, int *state, size_t *pos,
+           struct AcHit *hits, int maxHits)
+{
+    const unsigned char *s = (const unsigned char*)text;
+    const int *next = ac->next;
+    const int numClasses = ac->numClasses;
+    int st = *state;
+    size_t i = *pos;
+
+    while (i < len)
+    {
+        st = next[st * numClasses + ac->classOf[s[i++]]];
+        if (ac->outLink[st] < 0) continue;
+
+        int n = 0;
+        for (int t = ac->outLink[st]; t >= 0 && n < maxHits; t = ac->outLink[ac->fail[t]])
+        {
+            hits[n].pattern = ac->output[t];
+            hits[n].start = i - ac->patternLens[ac->output[t]];
+            n++;
+        }
+        *state = st;
+        *pos = i;
+        return n;
+    }
+
+    *state = st;
+    *pos = i;
+    return 0;
+}
@@ -0,0 +1,40 @@
+//
+// Created by 吨吨 on 2026/10/19.
+//
+
+#ifndef ACMATCH_H
+#define ACMATCH_H
+#include <stddef.h>
+
+// Aho-Corasick 多模式匹配自动机
+// 构建完成后是一张完整的 DFA 转移表，扫描时每个字节只查一次表，与模式数量无关；
+// 字节先映射到等价类（模式中没出现过的字节都归为第 0 类），以压缩转移表的宽度
+struct AhoCorasick
+{
+    int numPatterns;
+    char **patterns;           // 模式串，命中时用于输出
+    size_t *patternLens;
+    int icase;                 // 是否忽略大小写（仅 ASCII）
+
+    int numStates;
+    int numClasses;
+    unsigned char classOf[256]; // 字节 -> 等价类
+    int *next;                  // numStates * numClasses 的转移表
+    int *fail;                  // 失败链接
+    int *output;                // 状态对应的模式编号，-1 表示该状态不是某个模式的结尾
+    int *outLink;               // 沿失败链接（包括自身）遇到的第一个有输出的状态，-1 表示没有
+};
+
+// 一次命中：模式编号及其在文本中的起始偏移
+struct AcHit
+{
+    int pattern;
+    size_t start;
+};
+
+int acBuild(struct AhoCorasick *ac, char **patterns, int numPatterns, int icase);
+void acFree(struct AhoCorasick *ac);
+int acScan(const struct AhoCorasick *ac, const char *text, size_t len, int *state, size_t *pos,
+           struct AcHit *hits, int maxHits);
+
+#endif //ACMATCH_H
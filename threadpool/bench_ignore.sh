@@ -0,0 +1,45 @@
+#!/bin/bash
+#
+# .gitignore 剪枝的基准测试
+# 生成一棵带有大量被忽略子目录（build/、node_modules/、.git/）的目录树，
+# 分别用默认方式和 --no-ignore 搜索，比较耗时和搜索的文件数
+#
+# 用法：./bench_ignore.sh [pfind 路径] [被忽略目录中的子目录数]
+#
+
+PFIND=${1:-./pfind}
+IGNORED_DIRS=${2:-200}
+FILES_PER_DIR=100
+ROOT=$(mktemp -d /tmp/pfind_ignore_bench.XXXXXX)
+trap 'rm -rf "$ROOT"' EXIT
+
+echo "Generating tree in $ROOT ..."
+mkdir -p "$ROOT/src"
+for i in $(seq 1 $FILES_PER_DIR); do
+    echo "int main$i(void) { return $i; }" > "$ROOT/src/file$i.c"
+done
+for top in build node_modules .git; do
+    for d in $(seq 1 "$IGNORED_DIRS"); do
+        mkdir -p "$ROOT/$top/d$d"
+        for i in $(seq 1 $FILES_PER_DIR); do
+            : > "$ROOT/$top/d$d/file$i.c"
+        done
+    done
+done
+printf 'build/\nnode_modules/\n' > "$ROOT/.gitignore"
+
+total=$(find "$ROOT" -type f | wc -l)
+echo "Files in tree: $total"
+
+run() {
+    local start end count
+    start=$(date +%s.%N)
+    count=$("$PFIND" -p "$ROOT" -n '*.c' "$@" | grep -c '^Matched the file')
+    end=$(date +%s.%N)
+    awk -v n="${1:-default}" -v c="$count" -v s="$start" -v e="$end" 'BEGIN { printf "%-14s %8d files matched  %6.2f s\n", n, c, e - s }'
+}
+
+# 先跑一遍预热目录缓存
+"$PFIND" -p "$ROOT" -n '*.c' --no-ignore > /dev/null
+run
+run --no-ignore
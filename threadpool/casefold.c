@@ -0,0 +1,213 @@
+//
+// Created by 吨吨 on 2026/10/19.
+//
+#include "casefold.h"
+
+// 不是合法 UTF-8 的字节解码成这个范围内的值，不会与任何字符冲突，也不会被折叠
+#define INVALID_BYTE_BASE 0x110000
+
+/* * 把一个字符折叠成小写
+ *
+ * @param cp 码位
+ * @return 折叠后的码位，没有小写形式时原样返回
+ */
+uint32_t foldCodepoint(uint32_t cp)
+{
+    if (cp < 0x80) return (cp >= 'A' && cp <= 'Z') ? cp + 32 : cp;
+    // Latin-1：À-Þ，× 除外
+    if (cp >= 0xC0 && cp <= 0xDE && cp != 0xD7) return cp + 32;
+    // 拉丁扩展 A：大多是大写、小写相邻的一对，İ ı ĸ ŉ ſ 没有等长的对应字符
+    if (cp >= 0x100 && cp <= 0x17F)
+    {
+        if (cp == 0x130 || cp == 0x131 || cp == 0x138 || cp == 0x149 || cp == 0x17F) return cp;
+        if (cp == 0x178) return 0xFF; // Ÿ -> ÿ
+        // Ĺ-ň、Ź-ž 这两段是奇数为大写
+        if ((cp >= 0x139 && cp <= 0x148) || (cp >= 0x179 && cp <= 0x17E)) return (cp & 1) ? cp + 1 : cp;
+        return (cp & 1) ? cp : cp + 1;
+    }
+    // 希腊字母，词尾的 ς 也折叠成 σ
+    if (cp == 0x386) return 0x3AC;
+    if (cp >= 0x388 && cp <= 0x38A) return cp + 37;
+    if (cp == 0x38C) return 0x3CC;
+    if (cp == 0x38E || cp == 0x38F) return cp + 63;
+    if (cp >= 0x391 && cp <= 0x3AB && cp != 0x3A2) return cp + 32;
+    if (cp == 0x3C2) return 0x3C3;
+    // 西里尔字母
+    if (cp >= 0x400 && cp <= 0x40F) return cp + 80;
+    if (cp >= 0x410 && cp <= 0x42F) return cp + 32;
+    if ((cp >= 0x460 && cp <= 0x481) || (cp >= 0x48A && cp <= 0x4BF)) return (cp & 1) ? cp : cp + 1;
+    // 亚美尼亚字母
+    if (cp >= 0x531 && cp <= 0x556) return cp + 48;
+    // 全角拉丁字母
+    if (cp >= 0xFF21 && cp <= 0xFF3A) return cp + 32;
+    return cp;
+}
+
+/* * 列出与 cp 折叠结果相同的所有字符（包括 cp 自己）
+ *
+ * @param cp 码位
+ * @param out 输出，至少 CASE_MAX_VARIANTS 个
+ * @return 个数
+ */
+int caseVariants(uint32_t cp, uint32_t *out)
+{
+    uint32_t f = foldCodepoint(cp);
+    int n = 0;
+    out[n++] = f;
+    // foldCodepoint 只有这几种偏移，逐个反推出可能折叠成 f 的字符再验证
+    const uint32_t deltas[] = {1, 32, 37, 48, 63, 80};
+    uint32_t candidates[9];
+    int numCandidates = 0;
+    for (int i = 0; i < 6; i++)
+    {
+        if (f >= deltas[i]) candidates[numCandidates++] = f - deltas[i];
+    }
+    if (f == 0xFF) candidates[numCandidates++] = 0x178;
+    if (f == 0x3AC) candidates[numCandidates++] = 0x386;
+    if (f == 0x3CC) candidates[numCandidates++] = 0x38C;
+    for (int i = 0; i < numCandidates && n < CASE_MAX_VARIANTS; i++)
+    {
+        if (candidates[i] != f && foldCodepoint(candidates[i]) == f) out[n++] = candidates[i];
+    }
+    return n;
+}
+
+/* * 解码一个 UTF-8 字符
+ * 不合法的字节（孤立的后续字节、过长编码、被截断的序列）按单个字节处理
+ *
+ * @param s 文本
+ * @param len 最多读几个字节
+ * @param cp 输出：码位，不合法的字节是 INVALID_BYTE_BASE 加上字节值
+ * @return 这个字符占几个字节，至少为 1
+ */
+size_t utf8Decode(const unsigned char *s, size_t len, uint32_t *cp)
+{
+    unsigned char c = s[0];
+    if (c < 0x80)
+    {
+        *cp = c;
+        return 1;
+    }
+    // 按首字节得到长度、首字节中的有效位，以及这个长度能表示的最小码位（更小的是过长编码）
+    size_t n = 0;
+    uint32_t value = 0;
+    uint32_t min = 0;
+    if (c >= 0xC2 && c <= 0xDF)
+    {
+        n = 2;
+        value = c & 0x1F;
+        min = 0x80;
+    }
+    else if (c >= 0xE0 && c <= 0xEF)
+    {
+        n = 3;
+        value = c & 0x0F;
+        min = 0x800;
+    }
+    else if (c >= 0xF0 && c <= 0xF4)
+    {
+        n = 4;
+        value = c & 0x07;
+        min = 0x10000;
+    }
+
+    if (n == 0 || n > len)
+    {
+        *cp = INVALID_BYTE_BASE + c;
+        return 1;
+    }
+    for (size_t i = 1; i < n; i++)
+    {
+        if ((s[i] & 0xC0) != 0x80)
+        {
+            *cp = INVALID_BYTE_BASE + c;
+            return 1;
+        }
+        value = (value << 6) | (s[i] & 0x3F);
+    }
+    if (value < min || value > 0x10FFFF || (value >= 0xD800 && value <= 0xDFFF))
+    {
+        *cp = INVALID_BYTE_BASE + c;
+        return 1;
+    }
+    *cp = value;
+    return n;
+}
+
+/* * 把一个字符编码成 UTF-8
+ *
+ * @param cp 码位，不能是 utf8Decode 得到的不合法字节
+ * @param out 输出，至少 4 个字节
+ * @return 字节数
+ */
+size_t utf8Encode(uint32_t cp, unsigned char *out)
+{
+    if (cp < 0x80)
+    {
+        out[0] = (unsigned char)cp;
+        return 1;
+    }
+    if (cp < 0x800)
+    {
+        out[0] = (unsigned char)(0xC0 | (cp >> 6));
+        out[1] = (unsigned char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000)
+    {
+        out[0] = (unsigned char)(0xE0 | (cp >> 12));
+        out[1] = (unsigned char)(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (unsigned char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = (unsigned char)(0xF0 | (cp >> 18));
+    out[1] = (unsigned char)(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (unsigned char)(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = (unsigned char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+/* * 把一段文本折叠成小写，长度不变；dst 可以就是 src
+ *
+ * @param dst 输出，至少 len 个字节
+ * @param src 文本
+ * @param len 长度
+ * @param ascii 是否也折叠 ASCII 字母；交给 REG_ICASE 的正则本身不能折叠 ASCII（\W 和 \w 含义不同）
+ */
+void foldUtf8(char *dst, const char *src, size_t len, int ascii)
+{
+    const unsigned char *s = (const unsigned char*)src;
+    unsigned char *d = (unsigned char*)dst;
+    size_t i = 0;
+    while (i < len)
+    {
+        if (s[i] < 0x80)
+        {
+            d[i] = (ascii && s[i] >= 'A' && s[i] <= 'Z') ? (unsigned char)(s[i] + 32) : s[i];
+            i++;
+            continue;
+        }
+        uint32_t cp;
+        size_t n = utf8Decode(s + i, len - i, &cp);
+        uint32_t f = foldCodepoint(cp);
+        if (f != cp)
+        {
+            utf8Encode(f, d + i);
+        }
+        else if (d != s)
+        {
+            for (size_t k = 0; k < n; k++) d[i + k] = s[i + k];
+        }
+        i += n;
+    }
+}
+
+// 字符串中是否有非 ASCII 字节
+int hasNonAscii(const char *s)
+{
+    for (; *s; s++)
+    {
+        if ((unsigned char)*s >= 0x80) return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,23 @@
+//
+// Created by 吨吨 on 2026/10/19.
+//
+
+#ifndef CASEFOLD_H
+#define CASEFOLD_H
+#include <stddef.h>
+#include <stdint.h>
+
+// UTF-8 大小写折叠（-i）
+// 只做一对一、折叠前后 UTF-8 编码长度相同的简单折叠：ASCII、Latin-1、拉丁扩展 A、希腊、西里尔、亚美尼亚字母和全角拉丁字母，
+// 所以折叠后的文本与原文逐字节对齐，在折叠后的文本上得到的匹配偏移可以直接用在原文上；
+// 长度会变的折叠（ß -> ss、İ -> i̇）不处理。不是合法 UTF-8 的字节原样保留
+#define CASE_MAX_VARIANTS 3 // 一个字符最多有几种大小写形式（σ、ς、Σ）
+
+uint32_t foldCodepoint(uint32_t cp);
+int caseVariants(uint32_t cp, uint32_t *out);
+size_t utf8Decode(const unsigned char *s, size_t len, uint32_t *cp);
+size_t utf8Encode(uint32_t cp, unsigned char *out);
+void foldUtf8(char *dst, const char *src, size_t len, int ascii);
+int hasNonAscii(const char *s);
+
+#endif //CASEFOLD_H
@@ -0,0 +1,157 @@
+//
+// Created by 吨吨 on 2026/10/19.
+//
+#include "decompress.h"
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#define OUT_BUF_SIZE (256 * 1024)
+
+struct Decompressor
+{
+    int kind;
+    z_stream zs;
+#ifdef HAVE_ZSTD
+    ZSTD_DStream *zstd;
+#endif
+    char *out;
+};
+
+/* * 根据文件开头的魔数判断压缩格式
+ *
+ * @param buf 文件的第一块
+ * @param len 长度
+ * @return COMPRESS_NONE / COMPRESS_GZIP / COMPRESS_ZSTD，不支持的格式返回 COMPRESS_NONE
+ */
+int compressionKind(const char *buf, size_t len)
+{
+    const unsigned char *p = (const unsigned char*)buf;
+    if (len >= 2 && p[0] == 0x1f && p[1] == 0x8b) return COMPRESS_GZIP;
+#ifdef HAVE_ZSTD
+    if (len >= 4 && p[0] == 0x28 && p[1] == 0xb5 && p[2] == 0x2f && p[3] == 0xfd) return COMPRESS_ZSTD;
+#endif
+    return COMPRESS_NONE;
+}
+
+struct Decompressor *decompressorCreate(int kind)
+{
+    struct Decompressor *d = calloc(1, sizeof(struct Decompressor));
+    if (d == NULL) return NULL;
+    d->kind = kind;
+    d->out = malloc(OUT_BUF_SIZE);
+    if (d->out == NULL)
+    {
+        free(d);
+        return NULL;
+    }
+
+    int ok = 0;
+    if (kind == COMPRESS_GZIP)
+    {
+        // 15 + 16：只接受 gzip 头
+        ok = inflateInit2(&d->zs, 15 + 16) == Z_OK;
+    }
+#ifdef HAVE_ZSTD
+    else if (kind == COMPRESS_ZSTD)
+    {
+        d->zstd = ZSTD_createDStream();
+        ok = d->zstd != NULL && !ZSTD_isError(ZSTD_initDStream(d->zstd));
+    }
+#endif
+    if (!ok)
+    {
+#ifdef HAVE_ZSTD
+        if (d->zstd) ZSTD_freeDStream(d->zstd);
+#endif
+        free(d->out);
+        free(d);
+        return NULL;
+    }
+    return d;
+}
+
+void decompressorFree(struct Decompressor *d)
+{
+    if (d == NULL) return;
+    if (d->kind == COMPRESS_GZIP) inflateEnd(&d->zs);
+#ifdef HAVE_ZSTD
+    if (d->zstd) ZSTD_freeDStream(d->zstd);
+#endif
+    free(d->out);
+    free(d);
+}
+
+// 一直解压到输入用完并且输出缓冲区没有被填满为止：
+// 输入用完时 zlib 内部可能还留着没输出的数据，只要上一次把 out 填满了就要再调用一次
+static int feedGzip(struct Decompressor *d, const char *in, size_t len, DecompressSink sink, void *ctx)
+{
+    d->zs.next_in = (Bytef*)in;
+    d->zs.avail_in = (uInt)len;
+    do
+    {
+        d->zs.next_out = (Bytef*)d->out;
+        d->zs.avail_out = OUT_BUF_SIZE;
+        int ret = inflate(&d->zs, Z_NO_FLUSH);
+        size_t produced = OUT_BUF_SIZE - d->zs.avail_out;
+        if (produced > 0 && sink(ctx, d->out, produced) != 0) return 1;
+        if (ret == Z_STREAM_END)
+        {
+            // 多个 gzip 成员首尾相接（例如 cat a.gz b.gz），继续解压下一个
+            if (d->zs.avail_in == 0 || inflateReset(&d->zs) != Z_OK) return 0;
+            continue;
+        }
+        // Z_BUF_ERROR：没有任何进展，输入用完时只是在等下一块
+        if (ret == Z_BUF_ERROR) return d->zs.avail_in > 0 ? -1 : 0;
+        if (ret != Z_OK) return -1;
+    } while (d->zs.avail_in > 0 || d->zs.avail_out == 0);
+    return 0;
+}
+
+#ifdef HAVE_ZSTD
+static int feedZstd(struct Decompressor *d, const char *in, size_t len, DecompressSink sink, void *ctx)
+{
+    ZSTD_inBuffer input = {in, len, 0};
+    for (;;)
+    {
+        ZSTD_outBuffer output = {d->out, OUT_BUF_SIZE, 0};
+        size_t ret = ZSTD_decompressStream(d->zstd, &output, &input);
+        if (ZSTD_isError(ret)) return -1;
+        if (output.pos > 0 && sink(ctx, d->out, output.pos) != 0) return 1;
+        // 输出缓冲区被填满时解压器里可能还有数据
+        if (input.pos == input.size && output.pos < output.size) return 0;
+    }
+}
+#endif
+
+/* * 喂入一块压缩数据，解压出的数据全部交给 sink 之后才返回
+ *
+ * @param d 解压器
+ * @param in 压缩数据
+ * @param len 长度
+ * @param sink 回调
+ * @param ctx 传给回调的参数
+ * @return 0 成功，1 回调要求停止，-1 数据损坏
+ */
+int decompressorFeed(struct Decompressor *d, const char *in, size_t len, DecompressSink sink, void *ctx)
+{
+#ifdef HAVE_ZSTD
+    if (d->kind == COMPRESS_ZSTD) return feedZstd(d, in, len, sink, ctx);
+#endif
+    return feedGzip(d, in, len, sink, ctx);
+}
+
+/* * 压缩数据已经全部喂完，把解压器里还没输出的数据交给 sink
+ *
+ * @param d 解压器
+ * @param sink 回调
+ * @param ctx 传给回调的参数
+ * @return 0 成功，1 回调要求停止，-1 数据损坏
+ */
+int decompressorFinish(struct Decompressor *d, DecompressSink sink, void *ctx)
+{
+    return decompressorFeed(d, NULL, 0, sink, ctx);
+}
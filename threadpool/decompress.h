@@ -0,0 +1,26 @@
+//
+// Created by 吨吨 on 2026/10/19.
+//
+
+#ifndef DECOMPRESS_H
+#define DECOMPRESS_H
+#include <stddef.h>
+
+// 流式解压：压缩数据按块喂入，解压出的数据按块交给回调，不写临时文件
+// gzip 通过 zlib 支持；zstd 只有编译时定义了 HAVE_ZSTD（make ZSTD=1）才支持
+#define COMPRESS_NONE 0
+#define COMPRESS_GZIP 1
+#define COMPRESS_ZSTD 2
+
+struct Decompressor;
+
+// 解压出一块数据时调用，返回非0 表示不再需要后面的数据
+typedef int (*DecompressSink)(void *ctx, const char *data, size_t len);
+
+int compressionKind(const char *buf, size_t len);
+struct Decompressor *decompressorCreate(int kind);
+int decompressorFeed(struct Decompressor *d, const char *in, size_t len, DecompressSink sink, void *ctx);
+int decompressorFinish(struct Decompressor *d, DecompressSink sink, void *ctx);
+void decompressorFree(struct Decompressor *d);
+
+#endif //DECOMPRESS_H
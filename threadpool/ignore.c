@@ -0,0 +1,256 @@
+//
+// Created by 吨吨 on 2026/10/19.
+//
+#include "ignore.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* * 匹配方括号表达式，支持 [abc]、[a-z]、[!abc] 和 [^abc]
+ *
+ * @param p 指向 '[' 的指针，成功时更新为 ']' 之后的位置
+ * @param c 要匹配的字符
+ * @return 1 匹配，0 不匹配，-1 方括号没有闭合（按普通字符处理）
+ */
+static int matchBracket(const char **p, char c)
+{
+    const char *q = *p + 1;
+    int negate = 0;
+    if (*q == '!' || *q == '^')
+    {
+        negate = 1;
+        q++;
+    }
+
+    int matched = 0;
+    int first = 1;
+    while (*q != '\0' && (*q != ']' || first))
+    {
+        char lo = *q;
+        if (lo == '\\' && q[1] != '\0') lo = *++q;
+        char hi = lo;
+        if (q[1] == '-' && q[2] != '\0' && q[2] != ']')
+        {
+            hi = q[2];
+            q += 2;
+        }
+        if (c >= lo && c <= hi) matched = 1;
+        q++;
+        first = 0;
+    }
+    if (*q != ']') return -1;
+
+    *p = q + 1;
+    return matched != negate;
+}
+
+/* * gitignore 风格的通配符匹配
+ * '*' 和 '?' 不匹配 '/'；"**" 作为完整的一段时匹配任意多层目录
+ *
+ * @param pat 整个模式串，用来判断 "**" 是否在段首
+ * @param p 当前模式位置
+ * @param s 当前路径位置
+ * @return 1 匹配，0 不匹配
+ */
+static int globMatch(const char *pat, const char *p, const char *s)
+{
+    while (*p != '\0')
+    {
+        if (p[0] == '*' && p[1] == '*' && (p == pat || p[-1] == '/') && (p[2] == '/' || p[2] == '\0'))
+        {
+            // 结尾的 "**" 匹配剩下的所有内容
+            if (p[2] == '\0') return 1;
+            // "**/" 匹配零层或多层目录
+            p += 3;
+            while (1)
+            {
+                if (globMatch(pat, p, s)) return 1;
+                s = strchr(s, '/');
+                if (s == NULL) return 0;
+                s++;
+            }
+        }
+        if (*p == '*')
+        {
+            while (*p == '*') p++;
+            while (1)
+            {
+                if (globMatch(pat, p, s)) return 1;
+                if (*s == '\0' || *s == '/') return 0;
+                s++;
+            }
+        }
+        if (*s == '\0') return 0;
+        if (*p == '?')
+        {
+            if (*s == '/') return 0;
+            p++;
+            s++;
+            continue;
+        }
+        if (*p == '[')
+        {
+            int r = matchBracket(&p, *s);
+            if (r == 0 || *s == '/') return 0;
+            if (r == 1)
+            {
+                s++;
+                continue;
+            }
+        }
+        if (*p == '\\' && p[1] != '\0') p++;
+        if (*p != *s) return 0;
+        p++;
+        s++;
+    }
+    return *s == '\0';
+}
+
+/* * 解析一行规则
+ *
+ * @param line 一行内容，会被修改
+ * @param rule 输出
+ * @return 1 得到一条规则，0 空行或注释
+ */
+static int parseRule(char *line, struct IgnoreRule *rule)
+{
+    size_t len = strlen(line);
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) len--;
+    // 行尾的空格去掉，除非被反斜杠转义
+    while (len > 0 && line[len - 1] == ' ' && (len < 2 || line[len - 2] != '\\')) len--;
+    line[len] = '\0';
+    if (len == 0 || line[0] == '#') return 0;
+
+    memset(rule, 0, sizeof(*rule));
+    char *p = line;
+    if (*p == '!')
+    {
+        rule->negate = 1;
+        p++;
+    }
+    else if (*p == '\\' && (p[1] == '!' || p[1] == '#'))
+    {
+        p++;
+    }
+
+    len = strlen(p);
+    if (len > 0 && p[len - 1] == '/')
+    {
+        rule->dirOnly = 1;
+        p[--len] = '\0';
+    }
+    if (*p == '/')
+    {
+        rule->anchored = 1;
+        p++;
+        len--;
+    }
+    if (len == 0) return 0;
+    if (strchr(p, '/') != NULL) rule->anchored = 1;
+
+    // 预先判断规则的类型，大部分规则不需要走通配符匹配
+    rule->kind = IGNORE_GLOB;
+    if (strpbrk(p, "*?[\\") == NULL)
+    {
+        rule->kind = IGNORE_LITERAL;
+    }
+    else if (!rule->anchored && p[0] == '*' && strpbrk(p + 1, "*?[\\") == NULL)
+    {
+        rule->kind = IGNORE_SUFFIX;
+    }
+    rule->pattern = strdup(p);
+    rule->len = len;
+    return 1;
+}
+
+/* * 读取一个目录下的 .gitignore
+ *
+ * @param dir 目录路径
+ * @param parent 上层目录的规则列表，可以为 NULL
+ * @return 规则列表，文件不存在或没有规则时返回 NULL
+ */
+struct IgnoreList *ignoreLoad(const char *dir, const struct IgnoreList *parent)
+{
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/.gitignore", dir);
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) return NULL;
+
+    struct IgnoreList *list = calloc(1, sizeof(struct IgnoreList));
+    int cap = 0;
+    char *line = NULL;
+    size_t lineCap = 0;
+    while (getline(&line, &lineCap, fp) != -1)
+    {
+        struct IgnoreRule rule;
+        if (!parseRule(line, &rule)) continue;
+        if (list->numRules == cap)
+        {
+            cap = cap ? cap * 2 : 16;
+            list->rules = realloc(list->rules, sizeof(struct IgnoreRule) * cap);
+        }
+        list->rules[list->numRules++] = rule;
+    }
+    free(line);
+    fclose(fp);
+
+    if (list->numRules == 0)
+    {
+        free(list->rules);
+        free(list);
+        return NULL;
+    }
+    list->baseLen = strlen(dir);
+    list->parent = parent;
+    return list;
+}
+
+void ignoreFree(struct IgnoreList *list)
+{
+    if (list == NULL) return;
+    for (int i = 0; i < list->numRules; i++) free(list->rules[i].pattern);
+    free(list->rules);
+    free(list);
+}
+
+static int ruleMatches(const struct IgnoreRule *rule, const char *rel, const char *name)
+{
+    const char *subject = rule->anchored ? rel : name;
+    switch (rule->kind)
+    {
+        case IGNORE_LITERAL:
+            return strcmp(subject, rule->pattern) == 0;
+        case IGNORE_SUFFIX:
+        {
+            size_t n = strlen(subject);
+            return n >= rule->len - 1 && memcmp(subject + n - (rule->len - 1), rule->pattern + 1, rule->len - 1) == 0;
+        }
+        default:
+            return globMatch(rule->pattern, rule->pattern, subject);
+    }
+}
+
+/* * 判断一个文件或目录是否被忽略
+ * 越深的 .gitignore 优先，同一个文件中越靠后的规则优先，第一条匹配的规则决定结果
+ *
+ * @param list 当前目录生效的规则列表（最深的一层），可以为 NULL
+ * @param fullpath 完整路径，必须以各层 .gitignore 所在的目录开头
+ * @param name 文件名
+ * @param isDir 是否为目录
+ * @return 1 被忽略，0 不忽略
+ */
+int ignoreMatch(const struct IgnoreList *list, const char *fullpath, const char *name, int isDir)
+{
+    for (const struct IgnoreList *l = list; l != NULL; l = l->parent)
+    {
+        const char *rel = fullpath + l->baseLen;
+        if (*rel == '/') rel++;
+        for (int i = l->numRules - 1; i >= 0; i--)
+        {
+            const struct IgnoreRule *rule = &l->rules[i];
+            if (rule->dirOnly && !isDir) continue;
+            if (ruleMatches(rule, rel, name)) return !rule->negate;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,38 @@
+//
+// Created by 吨吨 on 2026/10/19.
+//
+
+#ifndef IGNORE_H
+#define IGNORE_H
+#include <stddef.h>
+
+// .gitignore 规则
+// 每个目录的 .gitignore 编译成一个 IgnoreList，子目录的列表通过 parent 指向上层目录的列表，
+// 判断时从最深的列表开始、每个列表内从最后一条规则开始，第一条匹配的规则决定结果
+#define IGNORE_LITERAL 0 // 没有通配符，直接比较
+#define IGNORE_SUFFIX 1  // "*.o" 这种形式，只比较后缀
+#define IGNORE_GLOB 2    // 一般的通配符
+
+struct IgnoreRule
+{
+    char *pattern;  // 去掉了开头的 '/'、'!' 和结尾的 '/'
+    size_t len;
+    int kind;       // IGNORE_LITERAL / IGNORE_SUFFIX / IGNORE_GLOB
+    int negate;     // "!" 开头：重新包含
+    int dirOnly;    // "/" 结尾：只匹配目录
+    int anchored;   // 含有 '/'：相对 .gitignore 所在目录匹配整个路径，否则只匹配文件名
+};
+
+struct IgnoreList
+{
+    struct IgnoreRule *rules;
+    int numRules;
+    size_t baseLen;                  // .gitignore 所在目录路径的长度，规则相对这个目录匹配
+    const struct IgnoreList *parent;
+};
+
+struct IgnoreList *ignoreLoad(const char *dir, const struct IgnoreList *parent);
+void ignoreFree(struct IgnoreList *list);
+int ignoreMatch(const struct IgnoreList *list, const char *fullpath, const char *name, int isDir);
+
+#endif //IGNORE_H
@@ -0,0 +1,626 @@
+//
+// Created by 吨吨 on 2026/10/19.
+//
+#include "literal.h"
+#include "casefold.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define LITERAL_X86 1
+#endif
+
+typedef const char *(*findFunc)(const struct LiteralMatcher *lm, const char *hay, size_t len);
+typedef size_t (*countFunc)(const char *buf, size_t len, unsigned char c);
+
+static const char *findScalar(const struct LiteralMatcher *lm, const char *hay, size_t len);
+static size_t countScalar(const char *buf, size_t len, unsigned char c);
+static findFunc findImpl = findScalar;
+static countFunc countImpl = countScalar;
+static pthread_once_t findOnce = PTHREAD_ONCE_INIT;
+
+static unsigned char foldLower(unsigned char c)
+{
+    return (c >= 'A' && c <= 'Z') ? (unsigned char)(c + 32) : c;
+}
+
+static unsigned char foldUpper(unsigned char c)
+{
+    return (c >= 'a' && c <= 'z') ? (unsigned char)(c - 32) : c;
+}
+
+/* * 估计一个字节在源码/日志文本中出现的频繁程度
+ * 数值越大越常见，编译时挑数值最小的两个字节作为过滤条件
+ *
+ * @param c 字节
+ * @return 频率估计值
+ */
+static int byteRank(unsigned char c)
+{
+    // 英文小写字母按出现频率从高到低排列
+    static const char *letters = "etaoinsrhldcumfpgwybvkxjqz";
+
+    if (c == ' ') return 255;
+    if (c >= 'a' && c <= 'z') return 250 - (int)(strchr(letters, c) - letters) * 4;
+    if (c >= 'A' && c <= 'Z') return 140 - (int)(strchr(letters, c + 32) - letters) * 2;
+    if (c >= '0' && c <= '9') return 150;
+    if (c == '\t' || c == '\n' || c == '\r') return 200;
+    if (c < 0x20 || c >= 0x80) return 10;
+    if (strchr("_()*;,.=-/\"'{}", c) != NULL) return 160; // 代码里常见的符号
+    return 60;
+}
+
+// 不能作为稀有字节的位置（这个位置上的字节有两种以上的大小写形式）
+#define RANK_UNUSABLE (1 << 20)
+
+/* * 忽略大小写时，求模式串第 i 个字节在另一种大小写形式中的值
+ * 非 ASCII 字符的各种形式编码长度相同（casefold.h），同一位置上的字节最多只能有两种值，否则不能用来过滤
+ *
+ * @param needle 折叠后的模式串
+ * @param len 长度
+ * @param i 下标
+ * @param alt 输出：另一种字节值，没有另一种形式时与原字节相同
+ * @return 1 可以用来过滤，0 不能
+ */
+static int altByte(const unsigned char *needle, size_t len, size_t i, unsigned char *alt)
+{
+    unsigned char c = needle[i];
+    *alt = c;
+    if (c < 0x80)
+    {
+        *alt = foldUpper(c);
+        return 1;
+    }
+
+    // 找到这个字节所在字符的开头
+    size_t start = i;
+    while (start > 0 && (needle[start] & 0xC0) == 0x80 && i - start < 3) start--;
+    uint32_t cp;
+    size_t n = utf8Decode(needle + start, len - start, &cp);
+    if (start + n <= i)
+    {
+        // 不属于任何合法字符的孤立字节，只能原样匹配
+        return 1;
+    }
+
+    uint32_t variants[CASE_MAX_VARIANTS];
+    int numVariants = caseVariants(cp, variants);
+    for (int v = 0; v < numVariants; v++)
+    {
+        unsigned char enc[4];
+        utf8Encode(variants[v], enc);
+        unsigned char b = enc[i - start];
+        if (b == c || b == *alt) continue;
+        if (*alt != c) return 0;
+        *alt = b;
+    }
+    return 1;
+}
+
+static int needleRank(const struct LiteralMatcher *lm, size_t i)
+{
+    unsigned char c = lm->needle[i];
+    if (!lm->icase) return byteRank(c);
+    unsigned char alt;
+    if (!altByte(lm->needle, lm->len, i, &alt)) return RANK_UNUSABLE;
+    int lo = byteRank(c), up = byteRank(alt);
+    return lo > up ? lo : up;
+}
+
+// 校验 s 处是否完整匹配模式串
+static int verifyAt(const struct LiteralMatcher *lm, const unsigned char *s)
+{
+    if (!lm->icase) return memcmp(s, lm->needle, lm->len) == 0;
+    if (!lm->utf8)
+    {
+        for (size_t i = 0; i < lm->len; i++)
+        {
+            if (foldLower(s[i]) != lm->needle[i]) return 0;
+        }
+        return 1;
+    }
+    // 折叠前后长度相同，文本中对应的字符也必须与模式串中的字符一样长
+    size_t i = 0;
+    while (i < lm->len)
+    {
+        if (lm->needle[i] < 0x80)
+        {
+            if (foldLower(s[i]) != lm->needle[i]) return 0;
+            i++;
+            continue;
+        }
+        uint32_t want, got;
+        size_t n = utf8Decode(lm->needle + i, lm->len - i, &want);
+        size_t m = utf8Decode(s + i, lm->len - i, &got);
+        if (m != n || foldCodepoint(got) != want) return 0;
+        i += n;
+    }
+    return 1;
+}
+
+// 没有 SIMD 时的实现：非忽略大小写时借助 memchr 跳到第一个稀有字节
+static const char *findScalar(const struct LiteralMatcher *lm, const char *hay, size_t len)
+{
+    const unsigned char *s = (const unsigned char*)hay;
+    size_t n = lm->len;
+    if (n == 0 || n > len) return NULL;
+
+    const unsigned char c1 = lm->needle[lm->rare1];
+    const unsigned char c2 = lm->needle[lm->rare2];
+    const unsigned char a1 = lm->alt1;
+    const unsigned char a2 = lm->alt2;
+    size_t last = len - n;
+    size_t i = 0;
+    while (i <= last)
+    {
+        if (!lm->icase)
+        {
+            const unsigned char *p = memchr(s + i + lm->rare1, c1, last - i + 1);
+            if (p == NULL) return NULL;
+            i = (size_t)(p - s) - lm->rare1;
+        }
+        else if (s[i + lm->rare1] != c1 && s[i + lm->rare1] != a1)
+        {
+            i++;
+            continue;
+        }
+
+        if ((s[i + lm->rare2] == c2 || s[i + lm->rare2] == a2) && verifyAt(lm, s + i))
+        {
+            return hay + i;
+        }
+        i++;
+    }
+    return NULL;
+}
+
+#ifdef LITERAL_X86
+__attribute__((target("sse2")))
+static const char *findSse2(const struct LiteralMatcher *lm, const char *hay, size_t len)
+{
+    const unsigned char *s = (const unsigned char*)hay;
+    size_t n = lm->len;
+    if (n == 0 || n > len) return NULL;
+
+    const unsigned char c1 = lm->needle[lm->rare1];
+    const unsigned char c2 = lm->needle[lm->rare2];
+    const __m128i lo1 = _mm_set1_epi8((char)c1), up1 = _mm_set1_epi8((char)lm->alt1);
+    const __m128i lo2 = _mm_set1_epi8((char)c2), up2 = _mm_set1_epi8((char)lm->alt2);
+
+    // 保证两次加载和候选位置的校验都不越界
+    size_t i = 0;
+    for (; i + n + 15 <= len; i += 16)
+    {
+        __m128i v1 = _mm_loadu_si128((const __m128i*)(s + i + lm->rare1));
+        __m128i v2 = _mm_loadu_si128((const __m128i*)(s + i + lm->rare2));
+        __m128i eq1 = _mm_or_si128(_mm_cmpeq_epi8(v1, lo1), _mm_cmpeq_epi8(v1, up1));
+        __m128i eq2 = _mm_or_si128(_mm_cmpeq_epi8(v2, lo2), _mm_cmpeq_epi8(v2, up2));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(eq1, eq2));
+        while (mask)
+        {
+            size_t pos = i + (size_t)__builtin_ctz(mask);
+            if (verifyAt(lm, s + pos)) return hay + pos;
+            mask &= mask - 1;
+        }
+    }
+
+    return findScalar(lm, hay + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static const char *findAvx2(const struct LiteralMatcher *lm, const char *hay, size_t len)
+{
+    const unsigned char *s = (const unsigned char*)hay;
+    size_t n = lm->len;
+    if (n == 0 || n > len) return NULL;
+
+    const unsigned char c1 = lm->needle[lm->rare1];
+    const unsigned char c2 = lm->needle[lm->rare2];
+    const __m256i lo1 = _mm256_set1_epi8((char)c1), up1 = _mm256_set1_epi8((char)lm->alt1);
+    const __m256i lo2 = _mm256_set1_epi8((char)c2), up2 = _mm256_set1_epi8((char)lm->alt2);
+
+    size_t i = 0;
+    for (; i + n + 31 <= len; i += 32)
+    {
+        __m256i v1 = _mm256_loadu_si256((const __m256i*)(s + i + lm->rare1));
+        __m256i v2 = _mm256_loadu_si256((const __m256i*)(s + i + lm->rare2));
+        __m256i eq1 = _mm256_or_si256(_mm256_cmpeq_epi8(v1, lo1), _mm256_cmpeq_epi8(v1, up1));
+        __m256i eq2 = _mm256_or_si256(_mm256_cmpeq_epi8(v2, lo2), _mm256_cmpeq_epi8(v2, up2));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_and_si256(eq1, eq2));
+        while (mask)
+        {
+            size_t pos = i + (size_t)__builtin_ctz(mask);
+            if (verifyAt(lm, s + pos)) return hay + pos;
+            mask &= mask - 1;
+        }
+    }
+
+    return findSse2(lm, hay + i, len - i);
+}
+
+// 每次比较得到的 0xFF 当作 -1 累加到各字节的计数器里，计数器最多 255，之前用 sad 横向求和清零
+__attribute__((target("sse2")))
+static size_t countSse2(const char *buf, size_t len, unsigned char c)
+{
+    const __m128i needle = _mm_set1_epi8((char)c);
+    const __m128i zero = _mm_setzero_si128();
+    size_t count = 0;
+    size_t i = 0;
+    while (i + 16 <= len)
+    {
+        __m128i acc = zero;
+        size_t end = i + 255 * 16 < len ? i + 255 * 16 : len;
+        for (; i + 16 <= end; i += 16)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i*)(buf + i));
+            acc = _mm_sub_epi8(acc, _mm_cmpeq_epi8(v, needle));
+        }
+        __m128i sum = _mm_sad_epu8(acc, zero);
+        count += (size_t)_mm_cvtsi128_si32(sum) + (size_t)_mm_extract_epi16(sum, 4);
+    }
+    return count + countScalar(buf + i, len - i, c);
+}
+
+__attribute__((target("avx2")))
+static size_t countAvx2(const char *buf, size_t len, unsigned char c)
+{
+    const __m256i needle = _mm256_set1_epi8((char)c);
+    const __m256i zero = _mm256_setzero_si256();
+    size_t count = 0;
+    size_t i = 0;
+    while (i + 32 <= len)
+    {
+        __m256i acc = zero;
+        size_t end = i + 255 * 32 < len ? i + 255 * 32 : len;
+        for (; i + 32 <= end; i += 32)
+        {
+            __m256i v = _mm256_loadu_si256((const __m256i*)(buf + i));
+            acc = _mm256_sub_epi8(acc, _mm256_cmpeq_epi8(v, needle));
+        }
+        __m256i sum = _mm256_sad_epu8(acc, zero);
+        __m128i half = _mm_add_epi64(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        count += (size_t)_mm_cvtsi128_si32(half) + (size_t)_mm_extract_epi16(half, 4);
+    }
+    return count + countSse2(buf + i, len - i, c);
+}
+#endif
+
+// 根据 CPU 支持的指令集选择实现，只执行一次
+static void selectImpl(void)
+{
+#ifdef LITERAL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        findImpl = findAvx2;
+        countImpl = countAvx2;
+    }
+    else if (__builtin_cpu_supports("sse2"))
+    {
+        findImpl = findSse2;
+        countImpl = countSse2;
+    }
+#endif
+}
+
+/* * 编译字面量匹配器
+ * 挑出模式串中最稀有的两个字节，并选择当前 CPU 可用的最快扫描实现；
+ * 忽略大小写时模式串先折叠成小写，稀有字节只从大小写形式不超过两种的位置中挑
+ *
+ * @param lm 匹配器
+ * @param pattern 模式串
+ * @param len 模式串长度
+ * @param icase 是否忽略大小写
+ * @return 0 成功，-1 失败
+ */
+int literalCompile(struct LiteralMatcher *lm, const char *pattern, size_t len, int icase)
+{
+    pthread_once(&findOnce, selectImpl);
+
+    memset(lm, 0, sizeof(*lm));
+    if (len == 0) return -1;
+
+    lm->needle = malloc(len);
+    if (lm->needle == NULL) return -1;
+    if (icase)
+    {
+        foldUtf8((char*)lm->needle, pattern, len, 1);
+    }
+    else
+    {
+        memcpy(lm->needle, pattern, len);
+    }
+    lm->len = len;
+    lm->icase = icase;
+    for (size_t i = 0; icase && i < len; i++)
+    {
+        if (lm->needle[i] >= 0x80) lm->utf8 = 1;
+    }
+
+    for (size_t i = 1; i < len; i++)
+    {
+        if (needleRank(lm, i) < needleRank(lm, lm->rare1)) lm->rare1 = i;
+    }
+
+    // 第二个字节尽量选与第一个不同的值，否则两个条件等于一个
+    lm->rare2 = lm->rare1;
+    int best = 1 << 30;
+    for (size_t i = 0; i < len; i++)
+    {
+        if (i == lm->rare1 || needleRank(lm, i) >= RANK_UNUSABLE) continue;
+        int rank = needleRank(lm, i) + (lm->needle[i] == lm->needle[lm->rare1] ? 256 : 0);
+        if (rank < best)
+        {
+            best = rank;
+            lm->rare2 = i;
+        }
+    }
+
+    lm->alt1 = lm->needle[lm->rare1];
+    lm->alt2 = lm->needle[lm->rare2];
+    if (icase)
+    {
+        altByte(lm->needle, len, lm->rare1, &lm->alt1);
+        altByte(lm->needle, len, lm->rare2, &lm->alt2);
+    }
+    return 0;
+}
+
+void literalFree(struct LiteralMatcher *lm)
+{
+    free(lm->needle);
+    lm->needle = NULL;
+    lm->len = 0;
+}
+
+/* * 在 hay 中查找模式串第一次出现的位置
+ *
+ * @param lm 匹配器
+ * @param hay 待搜索的缓冲区（不要求以 '\0' 结尾）
+ * @param len 缓冲区长度
+ * @return 命中位置，没有找到返回 NULL
+ */
+const char *literalFind(const struct LiteralMatcher *lm, const char *hay, size_t len)
+{
+    return findImpl(lm, hay, len);
+}
+
+static size_t countScalar(const char *buf, size_t len, unsigned char c)
+{
+    size_t count = 0;
+    const char *end = buf + len;
+    const char *p = buf;
+    while (p < end && (p = memchr(p, c, (size_t)(end - p))) != NULL)
+    {
+        count++;
+        p++;
+    }
+    return count;
+}
+
+// 统计缓冲区中某个字节出现的次数，用来计算行号
+size_t countByte(const char *buf, size_t len, unsigned char c)
+{
+    pthread_once(&findOnce, selectImpl);
+    return countImpl(buf, len, c);
+}
+
+/* * 判断 ERE 是否只是一个普通字符串（没有任何元字符）
+ * 被反斜杠转义的元字符视为普通字符，转义后的结果写入 out
+ *
+ * @param ere 正则表达式
+ * @param out 输出缓冲区
+ * @param outSize 输出缓冲区大小
+ * @return 1 是普通字符串，0 不是
+ */
+int isLiteralRegex(const char *ere, char *out, size_t outSize)
+{
+    size_t n = 0;
+    for (const char *p = ere; *p != '\0'; p++)
+    {
+        char c = *p;
+        if (c == '\\')
+        {
+            p++;
+            if (*p == '\0' || strchr(".[]()*+?{}|^$\\", *p) == NULL)
+            {
+                return 0; // \w、\1 之类的转义不是普通字符
+            }
+            c = *p;
+        }
+        else if (strchr(".[]()*+?{}|^$", c) != NULL)
+        {
+            return 0;
+        }
+
+        if (n + 1 >= outSize) return 0;
+        out[n++] = c;
+    }
+    out[n] = '\0';
+    return n > 0;
+}
+
+/* * 判断通配符是否是 "*xxx*" 形式，即"行内包含 xxx"
+ * 中间部分写入 out
+ *
+ * @param glob 通配符模式
+ * @param out 输出缓冲区
+ * @param outSize 输出缓冲区大小
+ * @return 1 是，0 不是
+ */
+int isLiteralGlob(const char *glob, char *out, size_t outSize)
+{
+    size_t len = strlen(glob);
+    if (len < 3 || glob[0] != '*' || glob[len - 1] != '*') return 0;
+
+    size_t n = 0;
+    for (size_t i = 1; i < len - 1; i++)
+    {
+        if (glob[i] == '*' || glob[i] == '?') return 0;
+        if (n + 1 >= outSize) return 0;
+        out[n++] = glob[i];
+    }
+    out[n] = '\0';
+    return n > 0;
+}
+
+/* * 跳过一个量词（*、+、?、{m,n}）
+ *
+ * @param p 指向可能的量词
+ * @param optional 输出：量词是否允许出现 0 次
+ * @return 量词之后的位置，没有量词时原样返回
+ */
+static const char *skipQuantifier(const char *p, int *optional)
+{
+    *optional = 0;
+    if (*p == '*' || *p == '?')
+    {
+        *optional = 1;
+        return p + 1;
+    }
+    if (*p == '+')
+    {
+        return p + 1;
+    }
+    if (*p == '{')
+    {
+        const char *q = p + 1;
+        if (*q < '1' || *q > '9') *optional = 1; // {0,n} 或 {,n}
+        while (*q != '\0' && *q != '}') q++;
+        return *q == '}' ? q + 1 : q;
+    }
+    return p;
+}
+
+// 跳过一个方括号表达式，p 指向 '['，返回 ']' 之后的位置
+static const char *skipBracket(const char *p)
+{
+    p++;
+    if (*p == '^') p++;
+    if (*p == ']') p++;
+    while (*p != '\0' && *p != ']')
+    {
+        if (*p == '[' && (p[1] == ':' || p[1] == '.' || p[1] == '='))
+        {
+            char close = p[1];
+            p += 2;
+            while (*p != '\0' && !(*p == close && p[1] == ']')) p++;
+            if (*p != '\0') p += 2;
+            continue;
+        }
+        p++;
+    }
+    return *p == ']' ? p + 1 : p;
+}
+
+// 跳过一个括号分组，p 指向 '('，返回 ')' 之后的位置
+static const char *skipGroup(const char *p)
+{
+    int depth = 0;
+    while (*p != '\0')
+    {
+        if (*p == '\\' && p[1] != '\0')
+        {
+            p += 2;
+            continue;
+        }
+        if (*p == '[')
+        {
+            p = skipBracket(p);
+            continue;
+        }
+        if (*p == '(') depth++;
+        if (*p == ')' && --depth == 0) return p + 1;
+        p++;
+    }
+    return p;
+}
+
+// 如果当前字符串比已记录的更长，就替换掉 out 中的结果
+static void keepLonger(const char *cur, size_t curLen, char *out, size_t outSize, size_t *bestLen)
+{
+    if (curLen > *bestLen && curLen < outSize)
+    {
+        memcpy(out, cur, curLen);
+        out[curLen] = '\0';
+        *bestLen = curLen;
+    }
+}
+
+/* * 从 ERE 中提取一个"必须出现"的最长普通字符串
+ * 只分析最外层的连接结构：遇到最外层的 '|' 直接放弃；
+ * 分组、方括号、'.'、锚点以及可以出现 0 次的字符都会截断当前字符串
+ * 例如 "foo.*bar" 得到 "foo"，"ab?cde+" 得到 "cde"
+ *
+ * @param ere 正则表达式
+ * @param out 输出缓冲区
+ * @param outSize 输出缓冲区大小
+ * @return 1 找到了长度不小于 2 的字符串，0 没有
+ */
+int regexRequiredLiteral(const char *ere, char *out, size_t outSize)
+{
+    char cur[1024];
+    size_t curLen = 0;
+    size_t bestLen = 0;
+    const char *p = ere;
+
+    // 最外层有 '|' 时每个分支需要的字符串都不一样，直接放弃
+    for (const char *q = ere; *q != '\0'; )
+    {
+        if (*q == '\\' && q[1] != '\0') q += 2;
+        else if (*q == '[') q = skipBracket(q);
+        else if (*q == '(') q = skipGroup(q);
+        else if (*q == '|') return 0;
+        else q++;
+    }
+
+    while (*p != '\0')
+    {
+        int c = -1; // 普通字符，-1 表示当前元素不是普通字符
+        if (*p == '\\' && p[1] != '\0' && strchr(".[]()*+?{}|^$\\", p[1]) != NULL)
+        {
+            c = (unsigned char)p[1];
+            p += 2;
+        }
+        else if (*p == '[')
+        {
+            p = skipBracket(p);
+        }
+        else if (*p == '(')
+        {
+            p = skipGroup(p);
+        }
+        else if (*p == '\\')
+        {
+            p += p[1] != '\0' ? 2 : 1;
+        }
+        else if (strchr(".^$*+?{}|)", *p) != NULL)
+        {
+            p++;
+        }
+        else
+        {
+            c = (unsigned char)*p++;
+        }
+
+        // 带量词的字符：可以出现 0 次的不算必需；'+'、{m,n} 的字符本身必需，但后面的字符不一定紧挨着它
+        int optional;
+        const char *next = skipQuantifier(p, &optional);
+        int quantified = next != p;
+        p = next;
+
+        if (c >= 0 && !optional && curLen + 1 < sizeof(cur))
+        {
+            cur[curLen++] = (char)c;
+        }
+        if (c < 0 || quantified)
+        {
+            keepLonger(cur, curLen, out, outSize, &bestLen);
+            curLen = 0;
+        }
+    }
+    keepLonger(cur, curLen, out, outSize, &bestLen);
+    return bestLen >= 2;
+}
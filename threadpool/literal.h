@@ -0,0 +1,33 @@
+//
+// Created by 吨吨 on 2026/10/19.
+//
+
+#ifndef LITERAL_H
+#define LITERAL_H
+#include <stddef.h>
+
+// 字面量匹配器
+// 编译时从模式串中挑出两个"稀有字节"，扫描时用 SIMD 同时比较这两个位置，
+// 只有两个字节都命中的候选位置才做完整比较，绝大多数字节根本不会进入校验
+// 忽略大小写时每个位置同时比较两种字节值（小写和大写），非 ASCII 字符按 UTF-8 折叠（见 casefold.h）
+struct LiteralMatcher
+{
+    unsigned char *needle; // 模式串，忽略大小写时已统一折叠成小写
+    size_t len;
+    int icase;             // 是否忽略大小写
+    int utf8;              // 忽略大小写并且模式串中有非 ASCII 字符，校验时逐个 UTF-8 字符折叠后比较
+    size_t rare1;          // 第一个稀有字节在模式串中的下标
+    size_t rare2;          // 第二个稀有字节在模式串中的下标
+    unsigned char alt1;    // 稀有字节在另一种大小写形式中的值，没有时等于 needle 中的字节
+    unsigned char alt2;
+};
+
+int literalCompile(struct LiteralMatcher *lm, const char *pattern, size_t len, int icase);
+void literalFree(struct LiteralMatcher *lm);
+const char *literalFind(const struct LiteralMatcher *lm, const char *hay, size_t len);
+size_t countByte(const char *buf, size_t len, unsigned char c);
+int isLiteralRegex(const char *ere, char *out, size_t outSize);
+int isLiteralGlob(const char *glob, char *out, size_t outSize);
+int regexRequiredLiteral(const char *ere, char *out, size_t outSize);
+
+#endif //LITERAL_H
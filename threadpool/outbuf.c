@@ -0,0 +1,234 @@
+//
+// Created by 吨吨 on 2026/10/19.
+//
+#include "outbuf.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define OUT_BUF_INIT_CAP (128 * 1024)
+#define OUT_BUF_FLUSH_SIZE (64 * 1024) // 文件处理完后缓冲区超过这个大小就写出
+
+static int outFd = 1;
+// 整个输出开头要去掉的分隔符（见 outDropLeading），以及是否已经写出过数据，都受 outMutex 保护
+static const char *leadingPrefix = NULL;
+static int wroteAny = 0;
+static struct OutBuf *allBufs = NULL;
+// 只保护 allBufs 链表和 write()，每一批结果只加一次锁
+static pthread_mutex_t outMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t outKey;
+static pthread_once_t outOnce = PTHREAD_ONCE_INIT;
+
+static void createOutKey(void)
+{
+    pthread_key_create(&outKey, NULL);
+}
+
+/* * 设置输出目标
+ * 之后的结果都直接写到 write 对应的文件描述符，不再经过 stdio
+ *
+ * @param write 输出文件
+ */
+void outInit(FILE *write)
+{
+    fflush(write);
+    outFd = fileno(write);
+}
+
+/* * 获取当前线程的输出缓冲区，第一次调用时创建
+ * 缓冲区挂在全局链表上，线程退出后里面剩余的结果由 outFlushAll 写出
+ *
+ * @return 输出缓冲区
+ */
+struct OutBuf *outLocal(void)
+{
+    pthread_once(&outOnce, createOutKey);
+    struct OutBuf *ob = pthread_getspecific(outKey);
+    if (ob != NULL) return ob;
+
+    ob = calloc(1, sizeof(struct OutBuf));
+    ob->data = malloc(OUT_BUF_INIT_CAP);
+    ob->cap = OUT_BUF_INIT_CAP;
+
+    pthread_mutex_lock(&outMutex);
+    ob->nextBuf = allBufs;
+    allBufs = ob;
+    pthread_mutex_unlock(&outMutex);
+
+    pthread_setspecific(outKey, ob);
+    return ob;
+}
+
+// 保证缓冲区还能再放下 n 个字节
+static void reserve(struct OutBuf *ob, size_t n)
+{
+    if (ob->len + n <= ob->cap) return;
+    size_t newCap = ob->cap ? ob->cap * 2 : 4096;
+    while (newCap < ob->len + n) newCap *= 2;
+    ob->data = realloc(ob->data, newCap);
+    ob->cap = newCap;
+}
+
+void outAppend(struct OutBuf *ob, const char *data, size_t len)
+{
+    reserve(ob, len);
+    memcpy(ob->data + ob->len, data, len);
+    ob->len += len;
+}
+
+void outAppendStr(struct OutBuf *ob, const char *str)
+{
+    outAppend(ob, str, strlen(str));
+}
+
+// 追加 n 个相同的字符，用于输出 ^ 前面的空格
+void outAppendRepeat(struct OutBuf *ob, char c, size_t n)
+{
+    reserve(ob, n);
+    memset(ob->data + ob->len, c, n);
+    ob->len += n;
+}
+
+// 追加十进制整数，不经过 printf
+void outAppendInt(struct OutBuf *ob, long long value)
+{
+    char tmp[24];
+    int pos = sizeof(tmp);
+    unsigned long long v = value < 0 ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+    do
+    {
+        tmp[--pos] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v > 0);
+    if (value < 0) tmp[--pos] = '-';
+    outAppend(ob, tmp + pos, sizeof(tmp) - pos);
+}
+
+/* * 追加一个带引号的 JSON 字符串
+ * 不需要转义的连续字节整段复制，只有引号、反斜杠和控制字符逐个转义；
+ * 不检查 UTF-8，非 ASCII 字节原样输出
+ *
+ * @param ob 输出缓冲区
+ * @param str 字符串，可以不以 '\0' 结尾
+ * @param len 长度
+ */
+void outAppendJson(struct OutBuf *ob, const char *str, size_t len)
+{
+    static const char hex[] = "0123456789abcdef";
+    reserve(ob, len + 2);
+    ob->data[ob->len++] = '"';
+    size_t start = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        unsigned char c = (unsigned char)str[i];
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+
+        outAppend(ob, str + start, i - start);
+        start = i + 1;
+        char esc[6] = {'\\', (char)c};
+        size_t n = 2;
+        if (c == '\n') esc[1] = 'n';
+        else if (c == '\t') esc[1] = 't';
+        else if (c == '\r') esc[1] = 'r';
+        else if (c < 0x20)
+        {
+            esc[1] = 'u';
+            esc[2] = '0';
+            esc[3] = '0';
+            esc[4] = hex[c >> 4];
+            esc[5] = hex[c & 0xf];
+            n = 6;
+        }
+        outAppend(ob, esc, n);
+    }
+    outAppend(ob, str + start, len - start);
+    outAppend(ob, "\"", 1);
+}
+
+/* * 设置只能出现在两段结果之间的分隔符
+ * 各个文件的结果以任意顺序写出，写入时无法知道前面还有没有别的结果，
+ * 所以每段结果前面都带上分隔符，真正写出的第一批数据如果以它开头就去掉
+ *
+ * @param prefix 分隔符，例如 "--\n"；NULL 表示不处理
+ */
+void outDropLeading(const char *prefix)
+{
+    leadingPrefix = prefix;
+}
+
+// 一个文件处理完毕，缓冲区攒够一批就写出
+void outFileDone(struct OutBuf *ob)
+{
+    if (ob->len >= OUT_BUF_FLUSH_SIZE) outFlush(ob);
+}
+
+// 把一段数据用一次 write() 写到输出目标（被信号打断或只写了一部分时继续写剩下的）
+void outWrite(const char *data, size_t len)
+{
+    pthread_mutex_lock(&outMutex);
+    if (!wroteAny && leadingPrefix != NULL)
+    {
+        size_t n = strlen(leadingPrefix);
+        if (len >= n && memcmp(data, leadingPrefix, n) == 0)
+        {
+            data += n;
+            len -= n;
+        }
+    }
+    if (len > 0) wroteAny = 1;
+    while (len > 0)
+    {
+        ssize_t n = write(outFd, data, len);
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+            break;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    pthread_mutex_unlock(&outMutex);
+}
+
+void outFlush(struct OutBuf *ob)
+{
+    if (ob->len == 0) return;
+    outWrite(ob->data, ob->len);
+    ob->len = 0;
+}
+
+/* * 写出所有缓冲区中剩余的结果
+ * 会访问其他线程的缓冲区，只能在没有任务运行时调用
+ */
+void outFlushAll(void)
+{
+    pthread_mutex_lock(&outMutex);
+    struct OutBuf *ob = allBufs;
+    pthread_mutex_unlock(&outMutex);
+
+    for (; ob != NULL; ob = ob->nextBuf)
+    {
+        outFlush(ob);
+    }
+}
+
+// 写出剩余结果并释放所有缓冲区，线程池销毁之后调用
+void outFreeAll(void)
+{
+    outFlushAll();
+
+    pthread_mutex_lock(&outMutex);
+    struct OutBuf *ob = allBufs;
+    allBufs = NULL;
+    pthread_mutex_unlock(&outMutex);
+
+    while (ob != NULL)
+    {
+        struct OutBuf *next = ob->nextBuf;
+        free(ob->data);
+        free(ob);
+        ob = next;
+    }
+}
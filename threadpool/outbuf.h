@@ -0,0 +1,36 @@
+//
+// Created by 吨吨 on 2026/10/19.
+//
+
+#ifndef OUTBUF_H
+#define OUTBUF_H
+#include <stddef.h>
+#include <stdio.h>
+
+// 输出缓冲区
+// 每个工作线程独占一块，匹配结果先追加到这里，攒够一批后用一次 write() 写出，
+// 只在一个文件处理完之后才可能写出，同一个文件的结果在输出中总是连续的
+// 清零的 struct OutBuf 也可以单独使用，作为不参与写出的私有缓冲区
+struct OutBuf
+{
+    char *data;
+    size_t len;
+    size_t cap;
+    struct OutBuf *nextBuf; // 所有缓冲区串成链表，结束时统一写出
+};
+
+void outInit(FILE *write);
+struct OutBuf *outLocal(void);
+void outAppend(struct OutBuf *ob, const char *data, size_t len);
+void outAppendStr(struct OutBuf *ob, const char *str);
+void outAppendRepeat(struct OutBuf *ob, char c, size_t n);
+void outAppendInt(struct OutBuf *ob, long long value);
+void outAppendJson(struct OutBuf *ob, const char *str, size_t len);
+void outDropLeading(const char *prefix);
+void outWrite(const char *data, size_t len);
+void outFileDone(struct OutBuf *ob);
+void outFlush(struct OutBuf *ob);
+void outFlushAll(void);
+void outFreeAll(void);
+
+#endif //OUTBUF_H
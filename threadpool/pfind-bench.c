@@ -0,0 +1,491 @@
+//
+// Created by 吨吨 on 2026/10/19.
+//
+// pfind 的基准测试
+// 按给定的参数生成一棵确定的目录树（同样的参数和种子总是生成同样的文件），
+// 然后分别以文件名、正则、内容模式运行 pfind，每种模式先跑冷缓存再跑热缓存，
+// 每次运行的实际耗时、CPU 时间和最大内存占用写成 CSV
+//
+#define _GNU_SOURCE // wait4
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <getopt.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+// 内容模式搜索的字符串，按 --density 的比例出现在文本行中，后面跟三位数字
+#define NEEDLE "pfind_needle"
+// 目录树根目录下的标记文件，记录生成时的参数，参数相同时直接复用
+#define STAMP_FILE ".pfind-bench"
+#define MAX_EXTRA_ARGS 32
+#define LINE_WIDTH 72
+
+struct treeSpec
+{
+    int depth;           // 目录层数，0 表示只有根目录
+    int fanout;          // 每个目录下的子目录数
+    int files;           // 每个目录下的文件数
+    long long minSize;   // 文件大小的范围，在对数尺度上均匀分布：小文件多，大文件少
+    long long maxSize;
+    double binaryRatio;  // 二进制文件的比例
+    double density;      // 文本文件中含有 NEEDLE 的行的比例
+    unsigned long long seed;
+};
+
+struct treeTotals
+{
+    long long dirs;
+    long long files;
+    long long bytes;
+};
+
+// 一种搜索方式：名字和传给 pfind 的参数
+struct benchMode
+{
+    const char *name;
+    const char *args[4];
+};
+
+static const struct benchMode modes[] =
+{
+    {"name", {"-n", "*7*", NULL}},
+    {"regex", {"-r", "^f[0-9]*3\\.(c|txt)$", NULL}},
+    {"content", {"-c", "-r", NEEDLE, NULL}},
+    {"content-regex", {"-c", "-r", "needle_[0-9]+7", NULL}},
+};
+#define NUM_MODES ((int)(sizeof(modes) / sizeof(modes[0])))
+
+static const char *words[] =
+{
+    "int", "char", "void", "static", "struct", "return", "while", "for", "if", "else",
+    "const", "buffer", "length", "thread", "queue", "mutex", "result", "index", "path", "file",
+};
+#define NUM_WORDS ((int)(sizeof(words) / sizeof(words[0])))
+
+// splitmix64：状态只有一个整数，同一个种子总是得到同一个序列
+static uint64_t nextRandom(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// [0, 1) 之间的随机数
+static double randomUnit(uint64_t *state)
+{
+    return (double)(nextRandom(state) >> 11) / (double)(1ULL << 53);
+}
+
+// 按对数尺度均匀地取一个文件大小
+static long long randomSize(uint64_t *state, const struct treeSpec *spec)
+{
+    if (spec->maxSize <= spec->minSize) return spec->minSize;
+    double lo = log((double)spec->minSize);
+    double hi = log((double)spec->maxSize);
+    return (long long)exp(lo + (hi - lo) * randomUnit(state));
+}
+
+/* * 生成一个文件
+ * 每个文件的内容只由种子和文件编号决定，与生成的顺序无关
+ *
+ * @param path 文件路径
+ * @param spec 目录树参数
+ * @param fileNo 文件编号
+ * @return 写入的字节数，失败返回 -1
+ */
+static long long writeFile(const char *path, const struct treeSpec *spec, long long fileNo)
+{
+    uint64_t state = spec->seed * 0x100000001b3ULL + (uint64_t)fileNo;
+    long long size = randomSize(&state, spec);
+    int binary = randomUnit(&state) < spec->binaryRatio;
+
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) return -1;
+    char line[LINE_WIDTH + 32];
+    long long written = 0;
+    while (written < size)
+    {
+        size_t len = 0;
+        if (binary)
+        {
+            // 二进制文件：随机字节，其中夹着 NUL，pfind 默认会跳过
+            for (; len < LINE_WIDTH; len++) line[len] = (char)(nextRandom(&state) & 0xff);
+            line[0] = '\0';
+        }
+        else
+        {
+            if (randomUnit(&state) < spec->density)
+            {
+                len += (size_t)snprintf(line, sizeof(line), "%s_%03d ", NEEDLE, (int)(nextRandom(&state) % 1000));
+            }
+            while (len < LINE_WIDTH - 8)
+            {
+                const char *w = words[nextRandom(&state) % NUM_WORDS];
+                size_t wl = strlen(w);
+                memcpy(line + len, w, wl);
+                len += wl;
+                line[len++] = ' ';
+            }
+            line[len - 1] = '\n';
+        }
+        if (written + (long long)len > size) len = (size_t)(size - written);
+        if (fwrite(line, 1, len, fp) != len) break;
+        written += (long long)len;
+    }
+    if (fclose(fp) != 0 || written < size) return -1;
+    return written;
+}
+
+/* * 递归生成一个目录及其下面的文件和子目录
+ *
+ * @param dir 目录路径，已经存在
+ * @param spec 目录树参数
+ * @param level 当前层数，根目录为 0
+ * @param totals 累计的目录数、文件数和字节数，文件编号也取自这里
+ * @return 0 成功，-1 失败
+ */
+static int generateDir(const char *dir, const struct treeSpec *spec, int level, struct treeTotals *totals)
+{
+    char path[4096];
+    totals->dirs++;
+    for (int i = 0; i < spec->files; i++)
+    {
+        // 扩展名交替使用，给文件名模式留出可以区分的部分
+        snprintf(path, sizeof(path), "%s/f%lld.%s", dir, totals->files, i % 2 ? "txt" : "c");
+        long long n = writeFile(path, spec, totals->files);
+        if (n < 0)
+        {
+            fprintf(stderr, "Fail to write %s: %s\n", path, strerror(errno));
+            return -1;
+        }
+        totals->files++;
+        totals->bytes += n;
+    }
+    if (level >= spec->depth) return 0;
+    for (int i = 0; i < spec->fanout; i++)
+    {
+        snprintf(path, sizeof(path), "%s/d%d", dir, i);
+        if (mkdir(path, 0755) != 0 || generateDir(path, spec, level + 1, totals) != 0)
+        {
+            fprintf(stderr, "Fail to create %s\n", path);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* * 准备目录树：根目录不存在时生成；已经存在并且标记文件中的参数相同时直接复用
+ * 不会删除或覆盖任何不是它生成的目录
+ *
+ * @param root 根目录
+ * @param spec 目录树参数
+ * @param totals 目录树的规模，复用时从标记文件中读出
+ * @return 0 成功，-1 失败
+ */
+static int prepareTree(const char *root, const struct treeSpec *spec, struct treeTotals *totals)
+{
+    char stamp[4096];
+    char params[256];
+    snprintf(stamp, sizeof(stamp), "%s/" STAMP_FILE, root);
+    snprintf(params, sizeof(params), "depth=%d fanout=%d files=%d size=%lld:%lld binary=%g density=%g seed=%llu",
+             spec->depth, spec->fanout, spec->files, spec->minSize, spec->maxSize,
+             spec->binaryRatio, spec->density, spec->seed);
+
+    struct stat st;
+    if (stat(root, &st) == 0)
+    {
+        char saved[256] = "";
+        FILE *fp = fopen(stamp, "r");
+        int ok = fp != NULL && fgets(saved, sizeof(saved), fp) != NULL &&
+                 strncmp(saved, params, strlen(params)) == 0 && saved[strlen(params)] == '\n' &&
+                 fscanf(fp, "%lld %lld %lld", &totals->dirs, &totals->files, &totals->bytes) == 3;
+        if (fp) fclose(fp);
+        if (!ok)
+        {
+            fprintf(stderr, "%s exists but was not generated with these parameters; remove it or use another --root\n", root);
+            return -1;
+        }
+        fprintf(stderr, "[Bench] Reusing %s (%s)\n", root, params);
+        return 0;
+    }
+
+    fprintf(stderr, "[Bench] Generating %s (%s)\n", root, params);
+    memset(totals, 0, sizeof(struct treeTotals));
+    if (mkdir(root, 0755) != 0 || generateDir(root, spec, 0, totals) != 0) return -1;
+    // 刚写完的页是脏页，先写回磁盘，冷缓存的 DONTNEED 才能把它们丢掉
+    sync();
+
+    FILE *fp = fopen(stamp, "w");
+    if (fp == NULL) return -1;
+    fprintf(fp, "%s\n%lld %lld %lld\n", params, totals->dirs, totals->files, totals->bytes);
+    fclose(fp);
+    return 0;
+}
+
+// nftw 的回调：让内核丢掉这个文件在页缓存中的内容
+static int dropFile(const char *path, const struct stat *st, int type, struct FTW *ftw)
+{
+    (void)st;
+    (void)ftw;
+    if (type != FTW_F) return 0;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+    return 0;
+}
+
+static double timevalSeconds(struct timeval tv)
+{
+    return (double)tv.tv_sec + (double)tv.tv_usec / 1e6;
+}
+
+/* * 运行一次 pfind
+ * 使用 --json，结果从标准输出读回来数行数，线程池的状态信息在 stderr 上，直接丢掉
+ *
+ * @param argv pfind 的参数，argv[0] 是 pfind 的路径
+ * @param wall 实际耗时（秒）
+ * @param usage 子进程的 CPU 时间和最大内存占用
+ * @return 结果条数，失败返回 -1
+ */
+static long long runOnce(char **argv, double *wall, struct rusage *usage)
+{
+    int fds[2];
+    if (pipe(fds) != 0) return -1;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+    if (pid == 0)
+    {
+        int devNull = open("/dev/null", O_WRONLY);
+        dup2(fds[1], STDOUT_FILENO);
+        if (devNull >= 0) dup2(devNull, STDERR_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+        execv(argv[0], argv);
+        _exit(127);
+    }
+
+    close(fds[1]);
+    long long results = 0;
+    char buf[65536];
+    ssize_t n;
+    while ((n = read(fds[0], buf, sizeof(buf))) != 0)
+    {
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (ssize_t i = 0; i < n; i++) results += buf[i] == '\n';
+    }
+    close(fds[0]);
+
+    int status;
+    while (wait4(pid, &status, 0, usage) < 0 && errno == EINTR)
+    {
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    *wall = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) return -1;
+    return results;
+}
+
+// 解析带 k、m、g 后缀的大小
+static int parseBytes(const char *s, long long *size)
+{
+    char *end;
+    long long n = strtoll(s, &end, 10);
+    if (end == s || n < 0) return -1;
+    int shift = 0;
+    if (*end == 'k' || *end == 'K') shift = 10;
+    else if (*end == 'm' || *end == 'M') shift = 20;
+    else if (*end == 'g' || *end == 'G') shift = 30;
+    if (shift) end++;
+    if (*end != '\0' && *end != ':') return -1;
+    n <<= shift;
+    *size = n;
+    return 0;
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [options]\n", prog);
+    printf("Generate a synthetic tree and time pfind on it; one CSV row per run.\n");
+    printf("  -p, --root <dir>    Where to generate the tree (default: /tmp/pfind-bench)\n");
+    printf("      --pfind <path>  The pfind binary to run (default: ./pfind)\n");
+    printf("      --depth <n>     Levels of subdirectories (default: 3)\n");
+    printf("      --fanout <n>    Subdirectories per directory (default: 4)\n");
+    printf("      --files <n>     Files per directory (default: 50)\n");
+    printf("      --size <min:max> File sizes, log-uniform between min and max (default: 1k:256k)\n");
+    printf("      --binary <ratio> Fraction of binary files (default: 0.05)\n");
+    printf("      --density <ratio> Fraction of text lines containing the search string (default: 0.001)\n");
+    printf("      --seed <n>      Random seed (default: 1)\n");
+    printf("      --cold <n>      Cold-cache runs per mode (default: 1)\n");
+    printf("      --warm <n>      Warm-cache runs per mode (default: 3)\n");
+    printf("      --extra <args>  Extra arguments for pfind, separated by spaces, e.g. \"--threads 4\"\n");
+    printf("  -o, --csv <file>    Write the CSV to <file> (default: standard output)\n");
+    printf("      --generate-only Only generate the tree\n");
+    printf("  -h, --help          Show this help message\n");
+}
+
+static struct option long_options[] =
+{
+    {"root", 1, NULL, 'p'},
+    {"pfind", 1, NULL, 'P'},
+    {"depth", 1, NULL, 'd'},
+    {"fanout", 1, NULL, 'F'},
+    {"files", 1, NULL, 'n'},
+    {"size", 1, NULL, 's'},
+    {"binary", 1, NULL, 'b'},
+    {"density", 1, NULL, 'm'},
+    {"seed", 1, NULL, 'S'},
+    {"cold", 1, NULL, 'C'},
+    {"warm", 1, NULL, 'W'},
+    {"extra", 1, NULL, 'x'},
+    {"csv", 1, NULL, 'o'},
+    {"generate-only", 0, NULL, 'g'},
+    {"help", 0, NULL, 'h'},
+    {0, 0, 0, 0}
+};
+
+int main(int argc, char *argv[])
+{
+    const char *root = "/tmp/pfind-bench";
+    const char *pfind = "./pfind";
+    const char *csvPath = NULL;
+    char *extra = NULL;
+    int cold = 1;
+    int warm = 3;
+    int generateOnly = 0;
+    struct treeSpec spec = {3, 4, 50, 1024, 256 * 1024, 0.05, 0.001, 1};
+
+    int ch;
+    while ((ch = getopt_long(argc, argv, "p:o:h", long_options, NULL)) != -1)
+    {
+        switch (ch)
+        {
+            case 'p': root = optarg; break;
+            case 'P': pfind = optarg; break;
+            case 'd': spec.depth = atoi(optarg); break;
+            case 'F': spec.fanout = atoi(optarg); break;
+            case 'n': spec.files = atoi(optarg); break;
+            case 's':
+            {
+                const char *colon = strchr(optarg, ':');
+                if (colon == NULL || parseBytes(optarg, &spec.minSize) != 0 ||
+                    parseBytes(colon + 1, &spec.maxSize) != 0 || spec.minSize <= 0 || spec.maxSize < spec.minSize)
+                {
+                    fprintf(stderr, "Invalid size range: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            }
+            case 'b': spec.binaryRatio = atof(optarg); break;
+            case 'm': spec.density = atof(optarg); break;
+            case 'S': spec.seed = strtoull(optarg, NULL, 10); break;
+            case 'C': cold = atoi(optarg); break;
+            case 'W': warm = atoi(optarg); break;
+            case 'x': extra = optarg; break;
+            case 'o': csvPath = optarg; break;
+            case 'g': generateOnly = 1; break;
+            case 'h':
+                usage(argv[0]);
+                return 0;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (spec.depth < 0 || spec.fanout < 0 || spec.files < 0 || cold < 0 || warm < 0)
+    {
+        fprintf(stderr, "Counts must not be negative\n");
+        return 1;
+    }
+
+    struct treeTotals totals;
+    if (prepareTree(root, &spec, &totals) != 0) return 1;
+    fprintf(stderr, "[Bench] %lld dirs, %lld files, %.1f MB\n",
+            totals.dirs, totals.files, (double)totals.bytes / (1024 * 1024));
+    if (generateOnly) return 0;
+    if (access(pfind, X_OK) != 0)
+    {
+        fprintf(stderr, "Can not run %s\n", pfind);
+        return 1;
+    }
+
+    FILE *csv = csvPath ? fopen(csvPath, "w") : stdout;
+    if (csv == NULL)
+    {
+        fprintf(stderr, "Fail to open %s\n", csvPath);
+        return 1;
+    }
+    fprintf(csv, "mode,cache,run,wall_s,user_s,sys_s,max_rss_kb,results,files,mb\n");
+
+    // pfind 的参数：路径、模式的参数、--json，再加上 --extra
+    char *args[16 + MAX_EXTRA_ARGS];
+    int fixed = 0;
+    args[fixed++] = (char*)pfind;
+    args[fixed++] = "-p";
+    args[fixed++] = (char*)root;
+    args[fixed++] = "--json";
+    char *extraCopy = extra ? strdup(extra) : NULL;
+    int numExtra = 0;
+    char *extraArgs[MAX_EXTRA_ARGS];
+    for (char *tok = extraCopy ? strtok(extraCopy, " ") : NULL; tok && numExtra < MAX_EXTRA_ARGS; tok = strtok(NULL, " "))
+    {
+        extraArgs[numExtra++] = tok;
+    }
+
+    int ret = 0;
+    for (int m = 0; m < NUM_MODES && ret == 0; m++)
+    {
+        int argn = fixed;
+        for (int i = 0; modes[m].args[i]; i++) args[argn++] = (char*)modes[m].args[i];
+        for (int i = 0; i < numExtra; i++) args[argn++] = extraArgs[i];
+        args[argn] = NULL;
+
+        for (int run = 0; run < cold + warm; run++)
+        {
+            int isCold = run < cold;
+            // 目录项和 inode 的缓存没法只针对这棵树丢掉，冷缓存只保证文件内容要从磁盘读
+            if (isCold) nftw(root, dropFile, 64, FTW_PHYS);
+
+            double wall;
+            struct rusage ru;
+            long long results = runOnce(args, &wall, &ru);
+            if (results < 0)
+            {
+                fprintf(stderr, "pfind failed in mode %s\n", modes[m].name);
+                ret = 1;
+                break;
+            }
+            fprintf(csv, "%s,%s,%d,%.4f,%.4f,%.4f,%ld,%lld,%lld,%.1f\n",
+                    modes[m].name, isCold ? "cold" : "warm", isCold ? run + 1 : run - cold + 1,
+                    wall, timevalSeconds(ru.ru_utime), timevalSeconds(ru.ru_stime), ru.ru_maxrss,
+                    results, totals.files, (double)totals.bytes / (1024 * 1024));
+            fflush(csv);
+        }
+    }
+
+    free(extraCopy);
+    if (csvPath) fclose(csv);
+    return ret;
+}
@@ -1,38 +1,65 @@
 //
 // Created by 吨吨 on 2025/6/10.
 //
-#include <dirent.h>
 #include <getopt.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
-#include <regex.h>
 #include <sys/time.h>
-#include <pthread.h>
 #include <sys/stat.h>
-#include "threadpool.h"
+#include "search.h"
+#include "outbuf.h"
+#include "stats.h"
+#include "casefold.h"
+#include "platform.h"
 
-// 全局文件写入互斥锁，防止多线程同时写入同一文件导致数据混乱
-pthread_mutex_t file_mutex = PTHREAD_MUTEX_INITIALIZER;
+// 命令行：解析参数、编译模式，再交给 search.c 中的搜索引擎
 
-void traverseAndScheduleSearch(const char *path, char *namePattern, regex_t *reg, FILE *write, struct ThreadPool *pool);
-void findWithPattern(void *arg);
-void findWithRegex(void *arg);
-int matchPattern(const char *filename, const char *pattern);
 static struct option long_options[];
 
-int matchContent = 0;
-
-// 任务体结构体
-struct taskBody
-{
-    char *path;
-    char *name; // 文件名
-    char *namePattern;
-    regex_t *reg;
-    FILE *write;
-};
+#define DEFAULT_ORDER_WINDOW 1024
+// 线程池的大小：--threads 指定时固定为这么多线程，否则按 CPU 个数和磁盘类型自动决定
+#define MAX_THREADS 1024
+#define HDD_THREADS 4          // 机械硬盘上同时读文件的线程再多也只会增加寻道
+#define MIN_QUEUE_CAPACITY 100 // 自动决定时任务队列至少这么长，每个线程再加 QUEUE_PER_THREAD
+#define QUEUE_PER_THREAD 16
+
+// 只有长选项的参数
+#define OPT_ORDERED 256
+#define OPT_SORT 257
+#define OPT_ORDER_WINDOW 258
+#define OPT_INDEX_BUILD 259
+#define OPT_INDEX 260
+#define OPT_INDEX_UPDATE 261
+#define OPT_WATCH 262
+#define OPT_BINARY 263
+#define OPT_NO_IGNORE 264
+#define OPT_MAX_DEPTH 265
+#define OPT_MIN_SIZE 266
+#define OPT_MAX_SIZE 267
+#define OPT_NEWER 268
+#define OPT_EXT 269
+#define OPT_TYPE 270
+#define OPT_COUNT 271
+#define OPT_MAX_COUNT 272
+#define OPT_IO_URING 273
+#define OPT_LOCALITY 274
+#define OPT_JSON 275
+#define OPT_NULL 276
+#define OPT_ALL_MATCHES 277
+#define OPT_REPLACE 278
+#define OPT_DRY_RUN 279
+#define OPT_STATS 280
+#define OPT_THREADS 281
+#define OPT_QUEUE_CAP 282
+
+static int parseSize(const char *s, long long *size);
+static int parseNewer(const char *s, int64_t *ns);
+static void addExtensions(const char *list);
+static char **loadPatternFile(const char *file, int *count);
+static void sizeThreadPool(const char *path, int numThreads, int *minThreads, int *maxThreads);
 
 /* * 主函数
  * 解析命令行参数，编译正则表达式，创建线程池并开始搜索指定路径下的文件
@@ -48,10 +75,22 @@ int main(const int argc, char *argv[])
     char *nameRegex = NULL;
     char *namePattern = NULL;
     char *outfile= NULL;
+    char *patternFile = NULL;
+    char literal[1024];
+    int ordered = 0;
+    long orderWindow = DEFAULT_ORDER_WINDOW;
+    char *indexBuildPath = NULL;
+    char *indexPath = NULL;
+    char *indexUpdatePath = NULL;
+    int watch = 0;
+    int useIoUring = 0;
+    int showStats = 0;
+    int numThreads = 0; // 0 表示自动决定
+    int queueCap = 0;
 
     // 解析命令行参数
     opterr = 0;
-    const char *shortOpts = "p:r:n:o:ch";
+    const char *shortOpts = "p:r:n:o:f:A:B:C:cilLzh";
     int ch;
     while ((ch = getopt_long(argc, argv, shortOpts, long_options, NULL)) != -1)
     {
@@ -69,9 +108,202 @@ int main(const int argc, char *argv[])
             case 'o':
                 outfile = optarg;
                 break;
+            case 'f':
+                patternFile = optarg;
+                break;
             case 'c':
                 matchContent = 1;
                 break;
+            case 'i':
+                ignoreCase = 1;
+                break;
+            case 'l':
+                matchContent = 1;
+                outputMode = OUTPUT_FILES;
+                break;
+            case 'L':
+                followLinks = 1;
+                break;
+            case 'z':
+                searchZip = 1;
+                break;
+            case OPT_COUNT:
+                matchContent = 1;
+                outputMode = OUTPUT_COUNT;
+                break;
+            case 'A':
+            case 'B':
+            case 'C':
+            {
+                char *end;
+                long n = strtol(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || n < 0 || n > INT_MAX)
+                {
+                    fprintf(stderr, "Invalid number of context lines: %s\n", optarg);
+                    return 1;
+                }
+                if (ch != 'B') contextAfter = (int)n;
+                if (ch != 'A') contextBefore = (int)n;
+                break;
+            }
+            case OPT_ALL_MATCHES:
+                allMatches = 1;
+                break;
+            case OPT_REPLACE:
+                matchContent = 1;
+                replaceText = optarg;
+                break;
+            case OPT_DRY_RUN:
+                dryRun = 1;
+                break;
+            case OPT_JSON:
+                outputFormat = FORMAT_JSON;
+                break;
+            case OPT_NULL:
+                outputFormat = FORMAT_NULL;
+                break;
+            case OPT_STATS:
+                showStats = 1;
+                break;
+            case OPT_THREADS:
+            {
+                if (strcmp(optarg, "auto") == 0)
+                {
+                    numThreads = 0;
+                    break;
+                }
+                char *end;
+                long n = strtol(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || n <= 0 || n > MAX_THREADS)
+                {
+                    fprintf(stderr, "Invalid thread count: %s (1 to %d, or auto)\n", optarg, MAX_THREADS);
+                    return 1;
+                }
+                numThreads = (int)n;
+                break;
+            }
+            case OPT_QUEUE_CAP:
+            {
+                char *end;
+                long n = strtol(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || n <= 0 || n > INT_MAX)
+                {
+                    fprintf(stderr, "Invalid queue capacity: %s\n", optarg);
+                    return 1;
+                }
+                queueCap = (int)n;
+                break;
+            }
+            case OPT_MAX_COUNT:
+            {
+                char *end;
+                maxCount = strtoll(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || maxCount <= 0)
+                {
+                    fprintf(stderr, "Invalid max count: %s\n", optarg);
+                    return 1;
+                }
+                atomic_store(&resultBudget, maxCount);
+                break;
+            }
+            case OPT_ORDERED:
+                ordered = 1;
+                break;
+            case OPT_SORT:
+                if (strcmp(optarg, "path") != 0)
+                {
+                    fprintf(stderr, "Unsupported sort key: %s\n", optarg);
+                    return 1;
+                }
+                ordered = 1;
+                sortByPath = 1;
+                break;
+            case OPT_ORDER_WINDOW:
+            {
+                char *end;
+                orderWindow = strtol(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || orderWindow <= 0 || orderWindow > INT_MAX)
+                {
+                    fprintf(stderr, "Invalid order window: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            }
+            case OPT_INDEX_BUILD:
+                indexBuildPath = optarg;
+                break;
+            case OPT_INDEX:
+                indexPath = optarg;
+                break;
+            case OPT_INDEX_UPDATE:
+                indexUpdatePath = optarg;
+                break;
+            case OPT_WATCH:
+                watch = 1;
+                break;
+            case OPT_BINARY:
+                if (strcmp(optarg, "skip") == 0) binaryPolicy = BINARY_SKIP;
+                else if (strcmp(optarg, "report") == 0) binaryPolicy = BINARY_REPORT;
+                else if (strcmp(optarg, "text") == 0) binaryPolicy = BINARY_TEXT;
+                else
+                {
+                    fprintf(stderr, "Unsupported binary mode: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case OPT_NO_IGNORE:
+                useIgnore = 0;
+                break;
+            case OPT_IO_URING:
+                useIoUring = 1;
+                break;
+            case OPT_LOCALITY:
+                if (strcmp(optarg, "inode") == 0) localityOrder = LOCALITY_INODE;
+                else if (strcmp(optarg, "extent") == 0) localityOrder = LOCALITY_EXTENT;
+                else
+                {
+                    fprintf(stderr, "Unsupported locality order: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case OPT_MAX_DEPTH:
+            {
+                char *end;
+                long n = strtol(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || n < 0 || n > INT_MAX)
+                {
+                    fprintf(stderr, "Invalid depth: %s\n", optarg);
+                    return 1;
+                }
+                maxDepth = (int)n;
+                break;
+            }
+            case OPT_MIN_SIZE:
+            case OPT_MAX_SIZE:
+                if (parseSize(optarg, ch == OPT_MIN_SIZE ? &minSize : &maxSize) != 0)
+                {
+                    fprintf(stderr, "Invalid size: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case OPT_NEWER:
+                if (parseNewer(optarg, &newerThanNs) != 0)
+                {
+                    fprintf(stderr, "Invalid time or reference file: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case OPT_EXT:
+                addExtensions(optarg);
+                break;
+            case OPT_TYPE:
+                if (strcmp(optarg, "f") != 0 && strcmp(optarg, "d") != 0)
+                {
+                    fprintf(stderr, "Unsupported type: %s\n", optarg);
+                    return 1;
+                }
+                typeFilter = optarg[0];
+                break;
 
             case 'h':
                 printf("Usage: %s [options] <path> <regex>\n", argv[0]);
@@ -80,11 +312,45 @@ int main(const int argc, char *argv[])
                 printf("  -p, --path <path>   Specify the path to search\n");
                 printf("  -n, --name <name>   Specify the file name pattern to match (supports * and ?)\n");
                 printf("  -r, --regex <regex> Specify the regex pattern to match\n");
+                printf("  -f, --pattern-file <file> Match any of the strings in <file> (one per line)\n");
+                printf("  -c, --content       Also match the pattern against file contents\n");
+                printf("  -i, --ignore-case   Ignore case in -n, -r, -f and content matching (UTF-8 aware except with -f)\n");
+                printf("  -l, --files-with-matches Only print the paths of matching files, stop reading a file at its first match\n");
+                printf("      --count         Only print the number of matching lines in each file\n");
+                printf("      --max-count <n> Stop the whole search after <n> results\n");
+                printf("  -A, -B, -C <n>      With -c, also print <n> lines after, before, or around each matching line\n");
+                printf("      --all-matches   With -c, report every match in a line, not only the first\n");
+                printf("      --replace <text> Replace every content match with <text> and rewrite the files (\\1 refers to a group)\n");
+                printf("      --dry-run       With --replace, print a unified diff instead of changing any file\n");
+                printf("      --json          Print one JSON object per result (NDJSON)\n");
+                printf("      --null          Print only the paths, each followed by a NUL byte (implies -l with -c)\n");
+                printf("  -L, --follow        Follow symbolic links; each directory is entered once, each file inode's content is searched once\n");
+                printf("  -z, --search-zip    With -c, also search inside .gz files (and .zst when built with ZSTD=1)\n");
                 printf("  -o, --output <file> Specify the output file (default: searchResult.txt)\n");
+                printf("      --ordered       Print results in traversal order, same as a sequential walk\n");
+                printf("      --sort=path     Like --ordered, with each directory visited in name order\n");
+                printf("      --order-window <n> Max files whose results may wait for reordering (default: %d)\n", DEFAULT_ORDER_WINDOW);
+                printf("      --index-build <file> Build a trigram index of <path> into <file> and exit\n");
+                printf("      --index <file>  Search the files recorded in <file>, reading only likely matches\n");
+                printf("      --index-update <file> Re-index only the files under <path> that changed since <file> was built\n");
+                printf("      --watch         After the first search, keep watching <path> and search files as they change\n");
+                printf("      --binary=<mode> How to handle binary files with -c: skip (default), report, text\n");
+                printf("      --no-ignore     Do not skip files matched by .gitignore, and descend into .git\n");
+                printf("      --io-uring      With -c, open and read files through io_uring on a dedicated I/O thread (Linux)\n");
+                printf("      --locality=<key> Schedule each directory's files by disk position: inode, extent (Linux)\n");
+                printf("      --max-depth <n> Descend at most <n> levels below <path> (1: only files directly in <path>)\n");
+                printf("      --min-size <size> Only search files of at least <size> bytes (suffixes k, m, g)\n");
+                printf("      --max-size <size> Only search files of at most <size> bytes (suffixes k, m, g)\n");
+                printf("      --newer <time|file> Only search files modified within <time> (30s, 10m, 2h, 7d) or after <file>\n");
+                printf("      --ext <list>    Only search files with one of these extensions, e.g. c,h\n");
+                printf("      --stats         After the search, print counts, time per phase, throughput and peak queue depth\n");
+                printf("      --threads <n|auto> Number of worker threads (default: auto, from the CPU count and disk type)\n");
+                printf("      --queue-cap <n> Capacity of the task queue (default: %d, plus %d per thread)\n", MIN_QUEUE_CAPACITY, QUEUE_PER_THREAD);
+                printf("      --type <f|d>    Match file names (f, default) or directory names (d)\n");
                 exit(EXIT_SUCCESS);
 
             case '?':
-                if (optopt == 'p' || optopt == 'r' || optopt == 'o')
+                if (optopt == 'p' || optopt == 'r' || optopt == 'o' || optopt == 'f')
                 {
                     fprintf(stderr, "Option -%c requires an argument.\n", optopt);
                 }
@@ -100,19 +366,140 @@ int main(const int argc, char *argv[])
         }
     }
 
+    // --replace 逐行改写文件内容，与只输出路径或行数的模式、目录名匹配和监视模式（会看到自己改写的文件）都不兼容
+    if (replaceText)
+    {
+        if (outputMode != OUTPUT_LINES || outputFormat == FORMAT_NULL || typeFilter == 'd' || watch ||
+            indexBuildPath || indexUpdatePath)
+        {
+            fprintf(stderr, "--replace can not be used with -l, --count, --null, --type d, --watch or --index-build\n");
+            return 1;
+        }
+        replaceLen = strlen(replaceText);
+        replaceRefs = strchr(replaceText, '\\') != NULL;
+        contextBefore = contextAfter = 0;
+    }
+    else if (dryRun)
+    {
+        fprintf(stderr, "--dry-run only works with --replace\n");
+        return 1;
+    }
+
+    // --null 只输出路径，逐行的结果没有地方放
+    if (outputFormat == FORMAT_NULL && outputMode == OUTPUT_LINES) outputMode = OUTPUT_FILES;
+    // -l 和 --count 不输出行，也就没有上下文
+    if (outputMode != OUTPUT_LINES) contextBefore = contextAfter = 0;
+
+    if (followLinks)
+    {
+        visited = visitedCreate();
+        if (visited == NULL)
+        {
+            printf("Fail to create the visited set\n");
+            return 1;
+        }
+    }
+
+    // 一开始就创建足够的线程，不用等管理线程每隔几秒两个两个地加
+    int minThreads, maxThreads;
+    sizeThreadPool(path, numThreads, &minThreads, &maxThreads);
+    if (queueCap == 0) queueCap = MIN_QUEUE_CAPACITY + QUEUE_PER_THREAD * maxThreads;
+
+    // 建索引：遍历所有文件，提取三字节组写入索引文件，不做任何匹配
+    // 增量更新时同样遍历整棵树，但 inode、大小和修改时间都没变的文件直接沿用旧索引，不再读取
+    if (indexBuildPath || indexUpdatePath)
+    {
+        const char *target = indexBuildPath ? indexBuildPath : indexUpdatePath;
+        indexBuilder = indexBuilderCreate(target);
+        if (indexBuilder == NULL)
+        {
+            printf("Fail to create the index builder\n");
+            return 1;
+        }
+        struct IndexReader *base = NULL;
+        if (indexUpdatePath)
+        {
+            base = indexOpen(indexUpdatePath);
+            if (base == NULL)
+            {
+                printf("[Index] No usable index at %s, building it from scratch\n", indexUpdatePath);
+            }
+            else if (indexBuilderSetBase(indexBuilder, base) != 0)
+            {
+                printf("Fail to load the index %s\n", indexUpdatePath);
+                return 1;
+            }
+        }
+
+        struct ThreadPool *pool = ThreadPoolCreate(maxThreads, minThreads, queueCap);
+        if (pool == NULL) return 1;
+        traverseAndScheduleSearch(path, NULL, NULL, pool);
+        ThreadPoolWait(pool);
+        uint32_t numFiles = indexBuilderFileCount(indexBuilder);
+        uint32_t numReused = indexBuilderReusedCount(indexBuilder);
+        // 倒排列表的合并也分段交给线程池
+        int ret = indexBuilderFinish(indexBuilder, pool);
+        ThreadPoolDestroy(pool);
+        indexClose(base);
+        if (ret != 0)
+        {
+            printf("Fail to write the index %s\n", target);
+            return 1;
+        }
+        printf("[Index] %u files, %u re-indexed, written to %s\n", numFiles, numFiles - numReused, target);
+        return 0;
+    }
+
     // 如果没有指定路径，使用当前目录
-    if (!nameRegex && !namePattern)
+    if (!nameRegex && !namePattern && !patternFile)
     {
-        printf("[Warning] Must specify either a regex or a name pattern.\n");
+        printf("[Warning] Must specify either a regex, a name pattern or a pattern file.\n");
         return 1;
     }
 
+    // 模式文件中的所有字符串编译成一个自动机，每个文件只需扫描一遍
+    struct AhoCorasick real_ac;
+    if (patternFile)
+    {
+        int count = 0;
+        char **patterns = loadPatternFile(patternFile, &count);
+        if (patterns == NULL || count == 0)
+        {
+            printf("Fail to read patterns from %s\n", patternFile);
+            free(patterns);
+            return 1;
+        }
+        int ret = acBuild(&real_ac, patterns, count, ignoreCase);
+        for (int i = 0; i < count; i++) free(patterns[i]);
+        free(patterns);
+        if (ret != 0)
+        {
+            printf("Fail to compile the patterns in %s\n", patternFile);
+            return 1;
+        }
+        patternSet = &real_ac;
+        nameRegex = NULL;
+        namePattern = NULL;
+    }
+
+    // -i：通配符整个折叠成小写；正则的 ASCII 部分交给 REG_ICASE，只折叠其中的非 ASCII 字符
+    if (ignoreCase && nameRegex)
+    {
+        foldText = hasNonAscii(nameRegex);
+        foldUtf8(nameRegex, nameRegex, strlen(nameRegex), 0);
+    }
+    else if (ignoreCase && namePattern)
+    {
+        foldText = 1;
+        foldUtf8(namePattern, namePattern, strlen(namePattern), 1);
+    }
+
     // 如果指定了正则表达式，则编译正则表达式，否则正则表达式的参数为NULL
     regex_t real_reg;
     regex_t *reg = NULL;
     if (nameRegex)
     {
-        if (regcomp(&real_reg, nameRegex, REG_EXTENDED) != 0)
+        if (regcomp(&real_reg, nameRegex, REG_EXTENDED | (ignoreCase ? REG_ICASE : 0)) != 0)
         {
             printf("Fail to compile the regex %s\n", nameRegex);
             return 1;
@@ -120,261 +507,270 @@ int main(const int argc, char *argv[])
         reg = &real_reg;
     }
 
+    // 内容匹配的模式如果只是普通字符串（"malloc"、"*malloc*"），就不必逐行跑正则或通配符，改用 SIMD 字面量查找
+    struct LiteralMatcher real_lit;
+    if (matchContent && !patternSet)
+    {
+        int isLiteral = nameRegex ? isLiteralRegex(nameRegex, literal, sizeof(literal))
+                                  : isLiteralGlob(namePattern, literal, sizeof(literal));
+        // 一般的正则里也常常含有必须出现的字符串（"foo.*bar" 中的 "foo"），先用它筛出候选行，再交给 regexec 确认
+        if (!isLiteral && nameRegex && regexRequiredLiteral(nameRegex, literal, sizeof(literal)))
+        {
+            isLiteral = 1;
+            literalPrefilter = 1;
+        }
+        if (isLiteral && strchr(literal, '\n') == NULL &&
+            literalCompile(&real_lit, literal, strlen(literal), ignoreCase) == 0)
+        {
+            contentLiteral = &real_lit;
+        }
+    }
+
+    // --replace 要知道每个匹配的确切范围，通配符只有在它本身就是普通字符串时才行
+    if (replaceText && !patternSet && !reg && contentLiteral == NULL)
+    {
+        printf("--replace needs a regex, a pattern file, or a name pattern that is a plain string such as *foo*\n");
+        return 1;
+    }
+
     // 如果没有指定输出文件，默认输出到标准输出
     FILE *write = outfile ? fopen(outfile,"a") : stdout;
+    // --json / --null 的结果是给其他程序读的：结果留在原来的标准输出上，
+    // 线程池的状态信息和警告改到 stderr，不和结果混在一起
+    if (outfile == NULL && outputFormat != FORMAT_TEXT)
+    {
+        write = fdopen(dup(STDOUT_FILENO), "w");
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+    }
     if (!write)
     {
         printf("Fail to open the file for writing\n");
         return 1;
     }
 
-    struct ThreadPool *pool = ThreadPoolCreate(30, 3, 100);
-    traverseAndScheduleSearch(path, namePattern, reg, write, pool);
-    sleep(1); // 等待所有任务入队，不然立即检查时，如果busyNum为0，可能还没开始就退出了
-    ThreadPoolWaitAndDestroy(pool);
+    // 结果先写入各线程的输出缓冲区，攒够一批再一次性写出
+    outInit(write);
+    // 带上下文时每组结果前面都有 "--"，第一组前面的不输出
+    if ((contextBefore > 0 || contextAfter > 0) && outputFormat == FORMAT_TEXT) outDropLeading("--\n");
+
+    // 有序模式下每个文件的结果先进入重排缓冲区，按遍历顺序写出
+    struct ReorderBuffer real_reorder;
+    if (ordered)
+    {
+        if (reorderInit(&real_reorder, (size_t)orderWindow) != 0)
+        {
+            printf("Fail to create the reorder buffer\n");
+            return 1;
+        }
+        reorder = &real_reorder;
+    }
+
+    // 有索引时不遍历目录，直接按索引中的文件表搜索
+    struct IndexReader *reader = NULL;
+    if (indexPath)
+    {
+        reader = indexOpen(indexPath);
+        if (reader == NULL)
+        {
+            printf("Fail to open the index %s\n", indexPath);
+            return 1;
+        }
+    }
+
+    // 内核不支持或者 io_uring 被禁用（容器的 seccomp 常常如此）时退回由工作线程自己读取
+    if (useIoUring && matchContent && typeFilter == 'f')
+    {
+        ioRing = ioRingCreate(IO_DEPTH, PREFETCH_SIZE, prefetchReady);
+        if (ioRing == NULL)
+        {
+            printf("[warning] io_uring is not available, falling back to blocking reads\n");
+        }
+    }
+
+    // --stats 只统计搜索本身，从创建线程池开始计时
+    if (showStats) statsEnable();
+    long long searchStart = statsClock();
+    struct ThreadPool *pool = ThreadPoolCreate(maxThreads, minThreads, queueCap);
+    if (pool == NULL) return 1;
+    if (reader)
+    {
+        // 索引中的三字节组按 ASCII 折叠过，-i 时 ASCII 模式照样可以筛选；
+        // 非 ASCII 字母的其他大小写形式在索引中是不同的字节，这时不能用索引排除文件
+        int useLiteral = contentLiteral && !(ignoreCase && hasNonAscii(literal));
+        scheduleFromIndex(reader, useLiteral ? literal : NULL, namePattern, reg, pool);
+    }
+    else
+    {
+        traverseAndScheduleSearch(path, namePattern, reg, pool);
+    }
+    // 遍历在当前线程中完成，返回时所有任务都已经入队；ThreadPoolWait 按未完成的任务数等待，
+    // 任务在执行中加入的任务也算在内，所以返回时没有任务还在运行
+    waitForSearch(pool);
+    long long flushStart = statsClock();
+    outFlushAll();
+    statsTime(STAT_OUTPUT, flushStart);
+    if (showStats) reportStats(pool, queueCap, statsClock() - searchStart);
+    // 监视模式：第一次搜索完成后不退出，之后只搜索新建或被修改的文件
+    int ret = 0;
+    if (watch && watchAndSearch(path, namePattern, reg, pool) != 0)
+    {
+        ret = 1;
+    }
+    ioRingDestroy(ioRing);
+    ThreadPoolDestroy(pool);
+    outFreeAll();
+    statsFreeAll();
+    if (reorder) {reorderDestroy(reorder);}
+    indexClose(reader);
 
     // 释放资源
     if (reg) {regfree(reg);}
+    if (contentLiteral) {literalFree(contentLiteral);}
+    if (patternSet) {acFree(patternSet);}
+    for (int i = 0; i < numExts; i++) free(extList[i]);
+    free(extList);
+    visitedFree(visited);
     fclose(write);
-    return 0;
+    return ret;
 }
 
-/* * 递归搜索指定路径下的所有子目录
- * 如果匹配正则表达式，则将结果写入到指定文件或标准输出
+/* * 决定线程池的最小和最大线程数
+ * 指定了线程数时固定为这么多；否则每个 CPU 一个线程起步，线程阻塞在 I/O 上、任务堆积时管理线程最多再加到两倍；
+ * 机械硬盘上并发读只会让磁头来回寻道，最多 HDD_THREADS 个线程
  *
- * @param path 需要搜索的路径
- * @param reg 正则表达式
- * @param namePattern 文件名模式字符串
- * @param write 输出文件指针，如果为NULL则输出到标准输出
- * @param pool 线程池指针
+ * @param path 搜索的根目录
+ * @param numThreads --threads 的值，0 表示自动
+ * @param minThreads 最小线程数，也是一开始创建的线程数
+ * @param maxThreads 最大线程数
  */
-void traverseAndScheduleSearch(const char *path, char* namePattern, regex_t *reg, FILE *write, struct ThreadPool *pool)
+static void sizeThreadPool(const char *path, int numThreads, int *minThreads, int *maxThreads)
 {
-    DIR *dir = opendir(path);
-    if (!dir) {
-        printf("[warning] Can not open dir:  %s\n", path);
+    if (numThreads > 0)
+    {
+        *minThreads = numThreads;
+        *maxThreads = numThreads;
         return;
     }
-
-    struct dirent *entry;
-    while ((entry = readdir(dir)) != NULL)
+    int cpus = cpuCount();
+    if (cpus > MAX_THREADS / 2) cpus = MAX_THREADS / 2;
+    if (isRotational(path))
     {
-        if (entry->d_type == DT_DIR)
-        {
-            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
-            {
-                continue;
-            }
-
-            size_t len = strlen(path) + strlen(entry->d_name) + 2; // +2 for '/' and '\0'
-            char *newPath = malloc(len);
-            snprintf(newPath, len, "%s/%s", path, entry->d_name);
-            traverseAndScheduleSearch(newPath, namePattern, reg, write, pool);
-            free(newPath);
-        }
-
-        if (entry->d_type == DT_REG)
-        {
-            // 在堆中构造任务体，释放是在regex函数中完成的
-            struct taskBody *task_body = malloc(sizeof(struct taskBody));
-            task_body->name = strdup(entry->d_name);
-            task_body->namePattern = namePattern;
-            task_body->write = write;
-
-            char fullpath[1024];
-            snprintf(fullpath, sizeof(fullpath), "%s/%s", path, entry->d_name);
-            task_body->path = malloc(strlen(fullpath) + 1);
-            strcpy(task_body->path, fullpath);
-
-            // 如果有正则表达式，则使用正则表达式匹配函数，否则使用模式匹配函数
-            if (reg != NULL)
-            {
-                task_body->reg = reg;
-                // 如果有正则表达式，则添加到线程池中执行
-                int ret = ThreadPoolAdd(pool, findWithRegex, task_body);
-                if (ret != 0) {
-                    printf("[Error] Fail to add task to thread pool: %d\n", ret);
-                    free(task_body->path);
-                    free(task_body);
-                    return;
-                }
-            } else
-            {
-                int ret = ThreadPoolAdd(pool, findWithPattern, task_body);
-                if (ret != 0) {
-                    printf("[Error] Fail to add task to thread pool: %d\n", ret);
-                    free(task_body->path);
-                    free(task_body);
-                    return;
-                }
-            }
-        }
+        *minThreads = cpus < HDD_THREADS ? cpus : HDD_THREADS;
+        *maxThreads = *minThreads;
+        return;
     }
-    closedir(dir);
+    *minThreads = cpus;
+    *maxThreads = cpus * 2;
 }
 
-/* * 模式匹配函数
- * 利用自定义的模式匹配函数来查找指定路径下的文件
- * 如果文件名匹配指定的模式，则将结果写入到指定文件或标准输出
+/* * 解析文件大小，支持 k、m、g 后缀（按 1024 进位）
  *
- * @param arg 任务体指针，包含路径、模式字符串和输出文件指针
+ * @param s 参数字符串，如 "4096"、"10k"、"1M"
+ * @param size 输出：字节数
+ * @return 0 成功，-1 格式错误
  */
-void findWithPattern(void *arg)
+static int parseSize(const char *s, long long *size)
 {
-    struct taskBody *task = (struct taskBody*)arg;
-    char *fullpath = task->path;
-    char *name = task->name;
-    char *namePattern = task->namePattern;
-    FILE *write = task->write;
-
-    struct stat st;
-    if (stat(fullpath, &st) == 0 && S_ISREG(st.st_mode))
+    char *end;
+    long long n = strtoll(s, &end, 10);
+    if (end == s || n < 0) return -1;
+    int shift = 0;
+    switch (*end)
     {
-        if (matchPattern(name, namePattern))
-        {
-            pthread_mutex_lock(&file_mutex);
-            fprintf(write, "Matched the file: %s\n", fullpath);
-            pthread_mutex_unlock(&file_mutex);
-        }
-
-        if (matchContent)
-        {
-            FILE *fp = fopen(fullpath, "r");
-            if (fp)
-            {
-                char line[1024];
-                int lineno = 0;
-                while (fgets(line, sizeof(line), fp))
-                {
-                    lineno++;
-                    if (matchPattern(line, namePattern))
-                    {
-                        pthread_mutex_lock(&file_mutex);
-                        fprintf(write, "Matched in file: %s\n", fullpath);
-                        fprintf(write, "=> %s [Line %d]\n\n", line, lineno);
-                        pthread_mutex_unlock(&file_mutex);
-                    }
-                }
-                fclose(fp);
-            }
-        }
+        case 'k': case 'K': shift = 10; end++; break;
+        case 'm': case 'M': shift = 20; end++; break;
+        case 'g': case 'G': shift = 30; end++; break;
+        default: break;
     }
-
-    free(task->path);
-    free(task);
-    // usleep(1000);
-    return;
+    if (*end != '\0' || n > (LLONG_MAX >> shift)) return -1;
+    *size = n << shift;
+    return 0;
 }
-
-
-/* * 正则表达式匹配函数
- * 该函数会在一个线程中执行，处理指定路径下的文件
- * 如果匹配成功，则打印或写入到指定文件
+/* * 解析 --newer 的参数：已存在的文件取它的修改时间，否则按 "30s"、"10m"、"2h"、"7d" 解释为距现在多久以内
  *
- * @param arg 任务体指针，包含路径、正则表达式和输出文件指针
+ * @param s 参数字符串
+ * @param ns 输出：修改时间下限，纳秒
+ * @return 0 成功，-1 既不是文件也不是时间长度
  */
-void findWithRegex(void *arg)
+static int parseNewer(const char *s, int64_t *ns)
 {
-    struct taskBody *task = (struct taskBody*)arg;
-    char *fullpath = task->path;
-    char *name = task->name;
-    const regex_t *reg = task->reg;
-    FILE *write = task->write;
-
     struct stat st;
-    if (stat(fullpath, &st) == 0 && S_ISREG(st.st_mode))
+    if (stat(s, &st) == 0)
     {
-        if (regexec(reg, name, 0, NULL, 0) == 0)
-        {
-            pthread_mutex_lock(&file_mutex);
-            fprintf(write, "Matched the file: %s\n", fullpath);
-            pthread_mutex_unlock(&file_mutex);
-        }
+        *ns = statMtimeNs(&st);
+        return 0;
+    }
 
-        if (matchContent)
-        {
-            FILE *fp = fopen(fullpath, "r");
-            if (fp)
-            {
-                char line[1024];
-                int lineno = 0;
-                regmatch_t match[1];
-                while (fgets(line, sizeof(line), fp))
-                {
-                    lineno++;
-                    if (regexec(reg, line, 1, match, 0) == 0)
-                    {
-                        pthread_mutex_lock(&file_mutex);
-                        fprintf(write, "Matched in file: %s\n", fullpath);
-                        fprintf(write, "=> %s [Line %d, Col %lld]\n", line, lineno, match[0].rm_so + 1);
-                        fprintf(write, "   ");
-                        for (int i = 0; i < match[0].rm_so; i++) fputc(' ', write);
-                        fprintf(write, "^\n");
-                        pthread_mutex_unlock(&file_mutex);
-                    }
-                }
-                fclose(fp);
-            }
-        }
+    char *end;
+    long long n = strtoll(s, &end, 10);
+    if (end == s || n < 0) return -1;
+    long long unit = 1;
+    switch (*end)
+    {
+        case 's': unit = 1; end++; break;
+        case 'm': unit = 60; end++; break;
+        case 'h': unit = 3600; end++; break;
+        case 'd': unit = 86400; end++; break;
+        default: break;
     }
+    if (*end != '\0') return -1;
 
-    free(task->path);
-    free(task);
-    // usleep(1000);
-    return;
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    *ns = ((int64_t)now.tv_sec - n * unit) * 1000000000 + (int64_t)now.tv_usec * 1000;
+    return 0;
 }
-
-
-/* * 模式匹配函数
- * 该函数使用递归方式实现通配符模式匹配
- * 支持 '*' 和 '?' 两种通配符
+/* * 把逗号分隔的扩展名加入 --ext 列表，开头的 '.' 可有可无
  *
- * @param filename 文件名
- * @param pattern 模式字符串
- * @return 1 如果匹配成功，0 如果匹配失败
+ * @param list 参数字符串，如 "c,h" 或 ".cpp"
  */
-int matchPattern(const char *filename, const char *pattern)
+static void addExtensions(const char *list)
 {
-    if (*pattern == '\0')
+    char *copy = strdup(list);
+    char *save = NULL;
+    for (char *ext = strtok_r(copy, ",", &save); ext != NULL; ext = strtok_r(NULL, ",", &save))
     {
-        return *filename == '\0';
+        if (*ext == '.') ext++;
+        if (*ext == '\0') continue;
+        extList = realloc(extList, sizeof(char*) * (numExts + 1));
+        extList[numExts++] = strdup(ext);
     }
-
-    if (*pattern == '*')
+    free(copy);
+}
+/* * 读取模式文件，每行一个字符串，忽略空行和行尾的 "\r\n"
+ *
+ * @param file 模式文件路径
+ * @param count 输出：模式数量
+ * @return 模式数组（数组和其中的字符串都需要调用者释放），打开文件失败返回 NULL
+ */
+static char **loadPatternFile(const char *file, int *count)
+{
+    FILE *fp = fopen(file, "r");
+    if (!fp) return NULL;
+
+    char **list = NULL;
+    int n = 0;
+    int cap = 0;
+    char *line = NULL;
+    size_t lineCap = 0;
+    ssize_t len;
+    while ((len = getline(&line, &lineCap, fp)) != -1)
     {
-        while (*(pattern + 1) == '*')
-        {
-            pattern += 1; // 跳过连续的星号
-        }
-
-        if (*(pattern + 1) == '\0')
-        {
-            return 1; // 如果模式是以星号结尾，匹配成功
-        }
-
-        for (; *filename != '\0'; filename++)
-        {
-            if (matchPattern(filename, pattern + 1))
-            {
-                return 1; // 如果后续匹配成功，返回成功
-            }
-        }
-
-        // 如果上面的循环没有找到匹配，那么filename此时已经是空字符串了，再匹配一下空字符看看
-        return matchPattern(filename, pattern + 1);
-    }
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) line[--len] = '\0';
+        if (len == 0) continue;
 
-    // 如果两个字符相同，或者模式字符是问号（问号匹配一个任意字符），向下匹配
-    if (*pattern == '?' || *pattern == *filename)
-    {
-        if (*filename == '\0')
+        if (n == cap)
         {
-            return 0;
+            cap = cap ? cap * 2 : 64;
+            list = realloc(list, sizeof(char*) * (size_t)cap);
         }
-        return matchPattern(filename + 1, pattern + 1);
+        list[n++] = strdup(line);
     }
 
-    return 0;
+    free(line);
+    fclose(fp);
+    *count = n;
+    return list;
 }
 
 // 长选项定义
@@ -384,7 +780,42 @@ static struct option long_options[] =
     {"regex", 1, NULL, 'r'},
     {"name", 1, NULL, 'n'},
     {"output", 1, NULL, 'o'},
+    {"pattern-file", 1, NULL, 'f'},
     {"content", 0, NULL, 'c'},
+    {"ignore-case", 0, NULL, 'i'},
+    {"files-with-matches", 0, NULL, 'l'},
+    {"count", 0, NULL, OPT_COUNT},
+    {"max-count", 1, NULL, OPT_MAX_COUNT},
+    {"after-context", 1, NULL, 'A'},
+    {"before-context", 1, NULL, 'B'},
+    {"context", 1, NULL, 'C'},
+    {"all-matches", 0, NULL, OPT_ALL_MATCHES},
+    {"replace", 1, NULL, OPT_REPLACE},
+    {"dry-run", 0, NULL, OPT_DRY_RUN},
+    {"json", 0, NULL, OPT_JSON},
+    {"null", 0, NULL, OPT_NULL},
+    {"follow", 0, NULL, 'L'},
+    {"search-zip", 0, NULL, 'z'},
     {"help", 0, NULL, 'h'},
+    {"ordered", 0, NULL, OPT_ORDERED},
+    {"sort", 1, NULL, OPT_SORT},
+    {"order-window", 1, NULL, OPT_ORDER_WINDOW},
+    {"index-build", 1, NULL, OPT_INDEX_BUILD},
+    {"index", 1, NULL, OPT_INDEX},
+    {"index-update", 1, NULL, OPT_INDEX_UPDATE},
+    {"watch", 0, NULL, OPT_WATCH},
+    {"binary", 1, NULL, OPT_BINARY},
+    {"no-ignore", 0, NULL, OPT_NO_IGNORE},
+    {"io-uring", 0, NULL, OPT_IO_URING},
+    {"locality", 1, NULL, OPT_LOCALITY},
+    {"max-depth", 1, NULL, OPT_MAX_DEPTH},
+    {"min-size", 1, NULL, OPT_MIN_SIZE},
+    {"max-size", 1, NULL, OPT_MAX_SIZE},
+    {"newer", 1, NULL, OPT_NEWER},
+    {"ext", 1, NULL, OPT_EXT},
+    {"type", 1, NULL, OPT_TYPE},
+    {"stats", 0, NULL, OPT_STATS},
+    {"threads", 1, NULL, OPT_THREADS},
+    {"queue-cap", 1, NULL, OPT_QUEUE_CAP},
     {0,0,0,0}
-};
\ No newline at end of file
+};
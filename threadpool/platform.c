@@ -0,0 +1,239 @@
+//
+// Created by 吨吨 on 2026/10/19.
+//
+#ifdef __linux__
+#define _GNU_SOURCE // sched_getaffinity
+#endif
+#include "platform.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sched.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#include <linux/fs.h>
+#include <linux/fiemap.h>
+#endif
+
+#ifdef SYS_getdents64
+// 一次 getdents64 最多读这么多字节的目录项，大约几百个，readdir 在 glibc 中也是这样批量读的，但每次只交出一个
+#define DIR_BUF_SIZE (64 * 1024)
+
+// 内核返回的目录项格式，glibc 的头文件里没有
+struct linuxDirent64
+{
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+struct DirStream
+{
+    int fd;
+    size_t pos;  // 下一个目录项在 buf 中的位置
+    size_t len;  // buf 中有效的字节数
+    _Alignas(8) char buf[DIR_BUF_SIZE];
+};
+#else
+struct DirStream
+{
+    DIR *dir;
+};
+#endif
+
+/* * 打开一个目录用来读目录项
+ *
+ * @param dirfd 上层目录的文件描述符，或 AT_FDCWD
+ * @param name 相对 dirfd 的路径
+ * @return 目录流，打不开时返回 NULL
+ */
+struct DirStream *dirStreamOpen(int dirfd, const char *name)
+{
+    int fd = openat(dirfd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+    struct DirStream *ds = malloc(sizeof(struct DirStream));
+    if (ds == NULL)
+    {
+        close(fd);
+        return NULL;
+    }
+#ifdef SYS_getdents64
+    ds->fd = fd;
+    ds->pos = 0;
+    ds->len = 0;
+#else
+    ds->dir = fdopendir(fd);
+    if (ds->dir == NULL)
+    {
+        close(fd);
+        free(ds);
+        return NULL;
+    }
+#endif
+    return ds;
+}
+
+/* * 读下一个目录项，"." 和 ".." 也会返回
+ *
+ * @param ds 目录流
+ * @param entry 输出：目录项
+ * @return 1 读到一项，0 已经读完，-1 出错
+ */
+int dirStreamRead(struct DirStream *ds, struct DirEntry *entry)
+{
+#ifdef SYS_getdents64
+    if (ds->pos >= ds->len)
+    {
+        long n = syscall(SYS_getdents64, ds->fd, ds->buf, sizeof(ds->buf));
+        if (n <= 0) return n == 0 ? 0 : -1;
+        ds->len = (size_t)n;
+        ds->pos = 0;
+    }
+    const struct linuxDirent64 *d = (const struct linuxDirent64*)(ds->buf + ds->pos);
+    ds->pos += d->d_reclen;
+    entry->name = d->d_name;
+    entry->type = d->d_type;
+    entry->ino = d->d_ino;
+    return 1;
+#else
+    struct dirent *d = readdir(ds->dir);
+    if (d == NULL) return 0;
+    entry->name = d->d_name;
+#ifdef DT_UNKNOWN
+    entry->type = d->d_type;
+#else
+    entry->type = 0;
+#endif
+    entry->ino = d->d_ino;
+    return 1;
+#endif
+}
+
+// 目录流的文件描述符，用来相对这个目录 openat、fstatat
+int dirStreamFd(const struct DirStream *ds)
+{
+#ifdef SYS_getdents64
+    return ds->fd;
+#else
+    return dirfd(ds->dir);
+#endif
+}
+
+void dirStreamClose(struct DirStream *ds)
+{
+    if (ds == NULL) return;
+#ifdef SYS_getdents64
+    close(ds->fd);
+#else
+    closedir(ds->dir);
+#endif
+    free(ds);
+}
+
+// 当前进程可以使用的 CPU 个数，taskset 或 cgroup 限制了亲和性时只算允许的那些
+int cpuCount(void)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0 && CPU_COUNT(&set) > 0) return CPU_COUNT(&set);
+#endif
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+/* * 判断 path 所在的块设备是不是机械硬盘
+ * 读 sysfs 中设备的 queue/rotational；分区没有自己的 queue 目录，要看它所属的整块磁盘
+ *
+ * @param path 搜索的根目录
+ * @return 1 机械硬盘，0 固态硬盘或者无法判断（tmpfs、网络文件系统、非 Linux）
+ */
+int isRotational(const char *path)
+{
+#ifdef __linux__
+    struct stat st;
+    if (stat(path, &st) != 0) return 0;
+    const char *formats[] = {"/sys/dev/block/%u:%u/queue/rotational", "/sys/dev/block/%u:%u/../queue/rotational"};
+    for (int i = 0; i < 2; i++)
+    {
+        char sysPath[128];
+        snprintf(sysPath, sizeof(sysPath), formats[i], major(st.st_dev), minor(st.st_dev));
+        FILE *fp = fopen(sysPath, "r");
+        if (fp == NULL) continue;
+        int rotational = fgetc(fp) == '1';
+        fclose(fp);
+        return rotational;
+    }
+#else
+    (void)path;
+#endif
+    return 0;
+}
+
+/* * 文件第一个区段在设备上的物理偏移
+ *
+ * @param dirfd 所在目录的文件描述符
+ * @param name 文件名
+ * @param offset 输出：物理偏移
+ * @return 0 成功，-1 文件系统不支持 FIEMAP、文件为空或者无法打开
+ */
+int physicalOffset(int dirfd, const char *name, unsigned long long *offset)
+{
+#ifdef FS_IOC_FIEMAP
+    int fd = openat(dirfd, name, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    struct
+    {
+        struct fiemap map;
+        struct fiemap_extent extent;
+    } req;
+    memset(&req, 0, sizeof(req));
+    req.map.fm_length = FIEMAP_MAX_OFFSET;
+    req.map.fm_extent_count = 1;
+    int ret = ioctl(fd, FS_IOC_FIEMAP, &req.map);
+    close(fd);
+    if (ret != 0 || req.map.fm_mapped_extents == 0) return -1;
+    *offset = req.extent.fe_physical;
+    return 0;
+#else
+    (void)dirfd;
+    (void)name;
+    (void)offset;
+    return -1;
+#endif
+}
+
+/* * 提示内核提前把文件读进页缓存
+ * 文件加入线程池时就发出，工作线程真正读到它之前，内核已经在后台按顺序预读了
+ *
+ * @param dirfd 所在目录的文件描述符
+ * @param name 文件名
+ */
+void adviseWillNeed(int dirfd, const char *name)
+{
+#ifdef POSIX_FADV_WILLNEED
+    int fd = openat(dirfd, name, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    close(fd);
+#else
+    (void)dirfd;
+    (void)name;
+#endif
+}
+
+// 文件的修改时间，精确到纳秒
+int64_t statMtimeNs(const struct stat *st)
+{
+#ifdef __APPLE__
+    return (int64_t)st->st_mtimespec.tv_sec * 1000000000LL + st->st_mtimespec.tv_nsec;
+#else
+    return (int64_t)st->st_mtim.tv_sec * 1000000000LL + st->st_mtim.tv_nsec;
+#endif
+}
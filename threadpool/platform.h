@@ -0,0 +1,41 @@
+//
+// Created by 吨吨 on 2026/10/19.
+//
+
+#ifndef PLATFORM_H
+#define PLATFORM_H
+#include <stdint.h>
+#include <sys/stat.h>
+// make PCRE2=1：没有 POSIX <regex.h> 的平台（例如 Windows 上的 MSYS2）改用 PCRE2 提供的同名接口
+#ifdef USE_PCRE2
+#define PCRE2_CODE_UNIT_WIDTH 8
+#include <pcre2posix.h>
+#else
+#include <regex.h>
+#endif
+
+// 与操作系统相关的部分集中在这里，搜索引擎只通过这些函数访问目录和设备信息
+// 读目录：Linux 上用 getdents64 一次读出一大批目录项，目录都相对上层目录用 openat 打开；其他系统退回 readdir
+
+struct DirStream;
+
+// 目录项，name 在下一次 dirStreamRead 之前有效
+struct DirEntry
+{
+    const char *name;
+    unsigned char type; // DT_REG、DT_DIR 等，文件系统不提供时为 DT_UNKNOWN
+    unsigned long long ino;
+};
+
+struct DirStream *dirStreamOpen(int dirfd, const char *name);
+int dirStreamRead(struct DirStream *ds, struct DirEntry *entry);
+int dirStreamFd(const struct DirStream *ds);
+void dirStreamClose(struct DirStream *ds);
+
+int cpuCount(void);
+int isRotational(const char *path);
+int physicalOffset(int dirfd, const char *name, unsigned long long *offset);
+void adviseWillNeed(int dirfd, const char *name);
+int64_t statMtimeNs(const struct stat *st);
+
+#endif //PLATFORM_H
@@ -0,0 +1,90 @@
+//
+// Created by 吨吨 on 2026/10/19.
+//
+#include "reorder.h"
+#include "outbuf.h"
+#include <stdlib.h>
+#include <string.h>
+
+int reorderInit(struct ReorderBuffer *rb, size_t window)
+{
+    memset(rb, 0, sizeof(*rb));
+    rb->slots = calloc(window, sizeof(struct ReorderSlot));
+    if (rb->slots == NULL) return -1;
+    rb->window = window;
+
+    if (pthread_mutex_init(&rb->mutex, NULL) != 0 ||
+        pthread_cond_init(&rb->notFull, NULL) != 0)
+    {
+        free(rb->slots);
+        return -1;
+    }
+    return 0;
+}
+
+void reorderDestroy(struct ReorderBuffer *rb)
+{
+    for (size_t i = 0; i < rb->window; i++) free(rb->slots[i].data);
+    free(rb->slots);
+    pthread_mutex_destroy(&rb->mutex);
+    pthread_cond_destroy(&rb->notFull);
+}
+
+/* * 遍历线程在分配序号 seq 之前调用
+ * 如果 seq 已经超出窗口（前面还有 window 个文件的结果没写出），就等待
+ *
+ * @param rb 重排缓冲区
+ * @param seq 即将分配的序号
+ */
+void reorderReserve(struct ReorderBuffer *rb, unsigned long long seq)
+{
+    pthread_mutex_lock(&rb->mutex);
+    while (seq >= rb->nextEmit + rb->window)
+    {
+        pthread_cond_wait(&rb->notFull, &rb->mutex);
+    }
+    pthread_mutex_unlock(&rb->mutex);
+}
+
+/* * 提交序号 seq 对应文件的全部结果（可以为空）
+ * 数据会被复制；如果 seq 正好是下一个要写出的序号，就连同后面已经就绪的结果一起写出
+ *
+ * @param rb 重排缓冲区
+ * @param seq 序号
+ * @param data 结果
+ * @param len 结果长度
+ */
+void reorderSubmit(struct ReorderBuffer *rb, unsigned long long seq, const char *data, size_t len)
+{
+    char *copy = NULL;
+    if (len > 0)
+    {
+        copy = malloc(len);
+        memcpy(copy, data, len);
+    }
+
+    pthread_mutex_lock(&rb->mutex);
+    struct ReorderSlot *slot = &rb->slots[seq % rb->window];
+    slot->ready = 1;
+    slot->data = copy;
+    slot->len = len;
+
+    int emitted = 0;
+    while (1)
+    {
+        slot = &rb->slots[rb->nextEmit % rb->window];
+        if (!slot->ready) break;
+
+        // 写出时仍持有锁，保证不同线程写出的结果不会交错
+        if (slot->len > 0) outWrite(slot->data, slot->len);
+        free(slot->data);
+        slot->data = NULL;
+        slot->len = 0;
+        slot->ready = 0;
+        rb->nextEmit++;
+        emitted = 1;
+    }
+    pthread_mutex_unlock(&rb->mutex);
+
+    if (emitted) pthread_cond_broadcast(&rb->notFull);
+}
@@ -0,0 +1,35 @@
+//
+// Created by 吨吨 on 2026/10/19.
+//
+
+#ifndef REORDER_H
+#define REORDER_H
+#include <pthread.h>
+#include <stddef.h>
+
+// 有序输出用的重排缓冲区
+// 遍历时给每个文件分配一个递增的序号，任务完成后按序号把结果放进对应的槽位，
+// 只有序号连续的结果才会写出；遍历最多领先已写出的序号 window 个文件，内存因此有上限
+struct ReorderSlot
+{
+    int ready;
+    char *data;
+    size_t len;
+};
+
+struct ReorderBuffer
+{
+    struct ReorderSlot *slots; // 环形数组，序号 seq 放在 slots[seq % window]
+    size_t window;
+    unsigned long long nextEmit; // 下一个要写出的序号
+
+    pthread_mutex_t mutex;
+    pthread_cond_t notFull;
+};
+
+int reorderInit(struct ReorderBuffer *rb, size_t window);
+void reorderDestroy(struct ReorderBuffer *rb);
+void reorderReserve(struct ReorderBuffer *rb, unsigned long long seq);
+void reorderSubmit(struct ReorderBuffer *rb, unsigned long long seq, const char *data, size_t len);
+
+#endif //REORDER_H
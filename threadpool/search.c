@@ -0,0 +1,2799 @@
+//
+// Created by 吨吨 on 2025/6/10.
+//
+#ifdef __linux__
+#define _GNU_SOURCE // statx
+#endif
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "search.h"
+#include "outbuf.h"
+#include "ignore.h"
+#include "decompress.h"
+#include "stats.h"
+#include "casefold.h"
+#include "platform.h"
+#ifdef __linux__
+#include <errno.h>
+#include <sys/inotify.h>
+#endif
+
+void findWithPattern(void *arg);
+void findWithRegex(void *arg);
+void findWithPatternSet(void *arg);
+void indexFileTask(void *arg);
+
+int matchContent = 0;
+// 内容匹配时使用的字面量匹配器，只有模式本身就是普通字符串时才启用
+struct LiteralMatcher *contentLiteral = NULL;
+// 字面量只是从正则中提取出的必需字符串，命中的行还需要用正则确认
+int literalPrefilter = 0;
+// -f 指定的模式文件编译出的多模式自动机
+struct AhoCorasick *patternSet = NULL;
+// -i：忽略大小写，除了 ASCII 还按 UTF-8 折叠常见的非 ASCII 字母（见 casefold.h）
+int ignoreCase = 0;
+// 通配符和含有非 ASCII 字符的正则要先把文件名和行折叠成小写再匹配；折叠不改变长度，匹配的偏移仍然对应原文
+int foldText = 0;
+
+// 有序输出：按遍历顺序写出结果；sortByPath 时每个目录内按名字排序后再遍历
+struct ReorderBuffer *reorder = NULL;
+int sortByPath = 0;
+unsigned long long nextSeq = 0; // 只在遍历线程中递增
+// --index-build 时的索引构建器，非空时遍历到的文件只建索引不搜索
+struct IndexBuilder *indexBuilder = NULL;
+
+// 二进制文件的处理方式，见 BINARY_SKIP 等
+int binaryPolicy = BINARY_SKIP;
+// -z：gzip（以及编译时启用的 zstd）压缩的文件边读边解压后搜索
+int searchZip = 0;
+// 遍历时按 .gitignore 剪掉被忽略的文件和目录，并且不进入 .git
+int useIgnore = 1;
+// 遍历时就地生效的过滤条件，被排除的文件不会产生任务
+int maxDepth = -1;           // 最多搜索几层，-1 表示不限
+long long minSize = -1;      // 文件大小下限（含），-1 表示不限
+long long maxSize = -1;      // 文件大小上限（含），-1 表示不限
+int64_t newerThanNs = INT64_MIN; // 只搜索修改时间晚于它的文件
+char **extList = NULL;       // 只搜索这些扩展名（不含 '.'）
+int numExts = 0;
+int typeFilter = 'f';        // 'f' 匹配文件，'d' 匹配目录名
+
+// 内容匹配结果的输出方式和结果的格式，见 OUTPUT_LINES、FORMAT_TEXT 等
+int outputMode = OUTPUT_LINES;
+int outputFormat = FORMAT_TEXT;
+// -A/-B/-C：匹配行后面、前面各输出几行上下文，只在逐行输出结果时有效
+int contextBefore = 0;
+int contextAfter = 0;
+// --all-matches：一行中的每个匹配各输出一条，而不只是第一个
+int allMatches = 0;
+// --replace：把内容中的匹配替换成 replaceText 并改写文件；--dry-run 时不改文件，输出 diff
+const char *replaceText = NULL;
+size_t replaceLen = 0;
+int replaceRefs = 0; // replaceText 中有反斜杠，需要展开 \1 这样的分组引用
+int dryRun = 0;
+// --max-count：所有线程共用的结果额度，用完后置位 cancelled，剩下的任务和遍历都直接放弃
+long long maxCount = -1;
+atomic_llong resultBudget;
+atomic_int cancelled;
+// --io-uring：内容搜索的文件先由 I/O 线程批量打开并读出第一块，再交给工作线程匹配
+struct IoRing *ioRing = NULL;
+
+// --locality：每个目录内的文件按磁盘上的位置排序后再交给线程池
+int localityOrder = LOCALITY_NONE;
+
+// -L：跟随符号链接；visited 记录访问过的目录和文件的 (dev, ino)，
+// 同一个目录只进入一次（避免链接成环和重复的绑定挂载），硬链接的同一个文件只搜索一次
+int followLinks = 0;
+struct VisitedSet *visited = NULL;
+
+#define MAX_LINE_HITS 64
+#define READ_BUF_SIZE (256 * 1024)
+// 只检查文件开头这么多字节来判断是不是二进制文件
+#define BINARY_SNIFF_SIZE 8192
+// 超过这个大小的文件切成多块，分给多个工作线程同时扫描
+#define CHUNK_THRESHOLD ((off_t)64 * 1024 * 1024)
+#define CHUNK_SIZE ((off_t)16 * 1024 * 1024)
+
+// 分块扫描时某条结果中行号的位置，行号等前面的块数完换行符后再填上
+struct lineFixup
+{
+    size_t offset; // 行号在块输出缓冲区中的位置
+    int lineno;    // 块内的行号，从 1 开始
+};
+
+// 行扫描器：文件内容按块喂入，只在完整的行上做匹配，块尾不完整的行暂存到下一块
+struct lineScanner
+{
+    const char *fullpath;
+    struct OutBuf *out;               // 当前线程的输出缓冲区
+    const regex_t *reg;               // 正则模式，输出带列号
+    const char *namePattern;          // 通配符模式，输出不带列号
+    const struct LiteralMatcher *lit; // 字面量模式，非空时跳过逐行匹配
+    const struct AhoCorasick *ac;     // 多模式，输出带列号和命中的模式
+    int verify;                       // 字面量只用来筛选候选行，候选行还要跑一遍 reg
+    int lineno;                       // 已经扫描过的行数
+    char *carry;                      // 跨块的半行
+    size_t carryLen;
+    size_t carryCap;
+    char *scratch;                    // 给需要 '\0' 结尾的匹配函数用的临时行
+    size_t scratchCap;
+    int binary;                       // 二进制文件：不输出匹配的行，只记录是否匹配
+    int matched;
+    int stop;                         // 不必再往下扫描：-l 已经命中，或者结果额度已经用完
+    long long count;                  // --count 时匹配的行数
+    int lastPrinted;                  // -A/-B/-C：最后输出的一行的行号，输出过的行不再作为前文输出
+    int afterLeft;                    // 上一个匹配行后面还要输出几行后文
+    char *history;                    // 之前的缓冲区末尾的 contextBefore 行，匹配行在缓冲区开头时从这里取前文
+    size_t historyLen;
+    size_t historyCap;
+    const struct IoPrefetch *prefetch; // io_uring 预读的第一块，没有时自己打开文件
+    int sniffed;                      // 压缩文件：解压出的第一块已经做过二进制判断
+    int deferLineno;                  // 分块扫描：行号先不输出，记录到 fixups
+    struct lineFixup *fixups;
+    size_t numFixups;
+    size_t fixupsCap;
+};
+
+static void scanFileContent(struct lineScanner *sc);
+static void reportFile(struct OutBuf *out, const char *fullpath, const char *pattern);
+static void reportJson(struct OutBuf *out, const char *type, const char *path, const char *pattern);
+static int takeResult(void);
+
+// 任务体结构体
+struct taskBody
+{
+    char *path;
+    char *name; // 文件名
+    char *namePattern;
+    regex_t *reg;
+    unsigned long long seq; // 有序输出时的序号
+    unsigned int fileId;    // 建索引时的文件编号
+    int skipContent;        // 索引表明文件不可能包含要找的内容，只匹配文件名
+    struct ThreadPool *pool; // 大文件分块时把各块加入这个线程池
+    void (*func)(void *arg);     // 使用 io_uring 时，预读完成后才把 func 加入线程池
+    struct IoPrefetch *prefetch; // io_uring 预读的结果
+};
+
+// 大文件中的一块：负责行首落在 [start, end) 之内的所有行，最后一行可以越过 end
+struct fileChunk
+{
+    off_t start;
+    off_t end;
+    size_t newlines;     // [start, end) 中的换行符个数，用来推算后面各块的行号
+    long long count;     // --count 时本块匹配的行数
+    int skipFirst;       // 块的第一行是从前一块延续过来的，不归这一块
+    struct OutBuf out;   // 本块的结果，行号留空
+    struct lineFixup *fixups;
+    size_t numFixups;
+};
+
+// 分块扫描的大文件，最后一个完成的块负责按顺序拼接所有块的结果
+struct chunkedFile
+{
+    struct taskBody *task;
+    struct lineScanner proto; // 各块共用的匹配设置
+    int nameMatched;
+    const char *namePattern;  // 文件名命中的模式，多模式匹配时输出
+    int numChunks;
+    int remaining;
+    pthread_mutex_t mutex;
+    struct fileChunk *chunks;
+};
+
+struct chunkTask
+{
+    struct chunkedFile *file;
+    int index;
+};
+
+static void finishFile(struct OutBuf *out, struct taskBody *task);
+static void releasePrefetch(struct taskBody *task);
+static int scanInChunks(struct taskBody *task, const struct lineScanner *proto, off_t size,
+                        int nameMatched, const char *namePattern);
+static int scheduleFile(const char *fullpath, const char *name, char *namePattern, regex_t *reg,
+                        struct ThreadPool *pool, int skipContent);
+static int statMatches(int dirfd, const char *statName);
+static int statFile(const char *path, struct stat *st);
+static void findDirName(void *arg);
+static void traverseDir(int parentFd, const char *dirName, const char *path, char *namePattern, regex_t *reg,
+                        struct ThreadPool *pool, const struct IgnoreList *parentIgnore, int depth);
+static int firstVisit(int dirfd, const char *name);
+static int firstContentVisit(const struct stat *st);
+
+// 目录项：先读完整个目录再逐个处理，方便按名字排序
+struct dirItem
+{
+    char *name;
+    unsigned char type;
+    unsigned long long ino;
+    unsigned long long key; // --locality 时的排序依据
+};
+
+static int compareDirItem(const void *a, const void *b)
+{
+    return strcmp(((const struct dirItem*)a)->name, ((const struct dirItem*)b)->name);
+}
+
+static int compareDirKey(const void *a, const void *b)
+{
+    unsigned long long ka = ((const struct dirItem*)a)->key;
+    unsigned long long kb = ((const struct dirItem*)b)->key;
+    return ka < kb ? -1 : ka > kb;
+}
+
+/* * 按磁盘上的位置给一个目录的目录项排序：文件在前，按 inode 或物理偏移升序；子目录在后，按 inode 升序
+ * 转动的磁盘和网络存储上，按这个顺序读文件可以避免来回寻道
+ *
+ * @param dirfd 目录的文件描述符
+ * @param items 目录项
+ * @param count 目录项个数
+ */
+static void sortByLocality(int dirfd, struct dirItem *items, size_t count)
+{
+    int useExtent = localityOrder == LOCALITY_EXTENT;
+    for (size_t i = 0; i < count; i++)
+    {
+        items[i].key = items[i].ino;
+        if (items[i].type == DT_DIR) continue;
+        // 只要有一个文件取不到物理偏移，整个目录就退回按 inode 排序，两种数值不能混在一起比较
+        if (useExtent && physicalOffset(dirfd, items[i].name, &items[i].key) != 0)
+        {
+            useExtent = 0;
+            for (size_t j = 0; j <= i; j++) items[j].key = items[j].ino;
+        }
+    }
+    qsort(items, count, sizeof(struct dirItem), compareDirKey);
+
+    // 子目录放在所有文件之后，保持各自的相对顺序
+    struct dirItem *sorted = malloc(sizeof(struct dirItem) * count);
+    if (sorted == NULL) return;
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (items[i].type != DT_DIR) sorted[n++] = items[i];
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        if (items[i].type == DT_DIR) sorted[n++] = items[i];
+    }
+    memcpy(items, sorted, sizeof(struct dirItem) * count);
+    free(sorted);
+}
+
+/* * 为一个普通文件构造任务体并加入线程池
+ * 有序模式下同时分配序号，序号超出重排窗口时会在这里等待
+ *
+ * @param fullpath 文件路径
+ * @param name 文件名
+ * @param namePattern 文件名模式字符串
+ * @param reg 正则表达式
+ * @param pool 线程池指针
+ * @param skipContent 是否跳过内容匹配
+ * @return 0 成功，非0 加入线程池失败
+ */
+static int scheduleFile(const char *fullpath, const char *name, char *namePattern, regex_t *reg,
+                        struct ThreadPool *pool, int skipContent)
+{
+    // 在堆中构造任务体，释放是在regex函数中完成的
+    struct taskBody *task_body = malloc(sizeof(struct taskBody));
+    task_body->name = strdup(name);
+    task_body->namePattern = namePattern;
+    task_body->reg = NULL;
+    task_body->seq = 0;
+    task_body->fileId = 0;
+    task_body->skipContent = skipContent;
+    task_body->pool = pool;
+    task_body->prefetch = NULL;
+    task_body->path = strdup(fullpath);
+
+    // 建索引时使用索引函数；有模式文件时使用多模式匹配函数，有正则表达式则使用正则表达式匹配函数，否则使用模式匹配函数
+    void (*func)(void *arg) = findWithPattern;
+    if (indexBuilder != NULL)
+    {
+        task_body->fileId = indexBuilderAddFile(indexBuilder, fullpath);
+        func = indexFileTask;
+    }
+    else if (typeFilter == 'd')
+    {
+        task_body->reg = reg;
+        func = findDirName;
+    }
+    else if (patternSet != NULL)
+    {
+        func = findWithPatternSet;
+    }
+    else if (reg != NULL)
+    {
+        task_body->reg = reg;
+        func = findWithRegex;
+    }
+
+    if (reorder && indexBuilder == NULL)
+    {
+        task_body->seq = nextSeq++;
+        reorderReserve(reorder, task_body->seq);
+    }
+
+    // 要读内容的文件先交给 I/O 线程，读出第一块后再由 prefetchReady 加入线程池
+    task_body->func = func;
+    if (ioRing != NULL && indexBuilder == NULL && typeFilter == 'f' && !skipContent &&
+        ioRingSubmit(ioRing, task_body->path, task_body) == 0)
+    {
+        return 0;
+    }
+
+    int ret = ThreadPoolAdd(pool, func, task_body);
+    if (ret != 0) {
+        printf("[Error] Fail to add task to thread pool: %d\n", ret);
+        // 占住的序号也要提交，否则后面的结果永远等不到写出
+        if (reorder) reorderSubmit(reorder, task_body->seq, NULL, 0);
+        free(task_body->path);
+        free(task_body->name);
+        free(task_body);
+    }
+    return ret;
+}
+
+/* * 文件名的扩展名是否在 --ext 列表中，没有指定 --ext 时总是满足
+ *
+ * @param name 文件名
+ * @return 1 满足，0 不满足
+ */
+static int extMatches(const char *name)
+{
+    if (numExts == 0) return 1;
+    const char *dot = strrchr(name, '.');
+    if (dot == NULL || dot == name) return 0;
+    for (int i = 0; i < numExts; i++)
+    {
+        if (strcmp(dot + 1, extList[i]) == 0) return 1;
+    }
+    return 0;
+}
+
+/* * 取文件的大小和修改时间
+ * Linux 上用 statx 只取需要的两个字段，内核不支持时退回 fstatat
+ *
+ * @param dirfd 所在目录的文件描述符，或 AT_FDCWD
+ * @param statName 相对 dirfd 的路径
+ * @param size 文件大小
+ * @param mtimeNs 修改时间，精确到纳秒
+ * @return 0 成功，-1 无法获取
+ */
+static int statSizeMtime(int dirfd, const char *statName, long long *size, int64_t *mtimeNs)
+{
+    int noFollow = followLinks ? 0 : AT_SYMLINK_NOFOLLOW;
+#ifdef STATX_SIZE
+    static int noStatx = 0;
+    struct statx stx;
+    if (!noStatx && statx(dirfd, statName, noFollow | AT_STATX_DONT_SYNC,
+                          STATX_SIZE | STATX_MTIME, &stx) == 0)
+    {
+        *size = (long long)stx.stx_size;
+        *mtimeNs = (int64_t)stx.stx_mtime.tv_sec * 1000000000 + stx.stx_mtime.tv_nsec;
+        return 0;
+    }
+    if (errno != ENOSYS) return -1;
+    noStatx = 1;
+#endif
+    struct stat st;
+    if (fstatat(dirfd, statName, &st, noFollow) != 0) return -1;
+    *size = (long long)st.st_size;
+    *mtimeNs = statMtimeNs(&st);
+    return 0;
+}
+
+/* * 检查大小和修改时间是否满足过滤条件，没有这类条件时不做任何系统调用
+ *
+ * @param dirfd 所在目录的文件描述符，或 AT_FDCWD
+ * @param statName 相对 dirfd 的路径
+ * @return 1 满足，0 不满足或无法获取
+ */
+static int statMatches(int dirfd, const char *statName)
+{
+    if (minSize < 0 && maxSize < 0 && newerThanNs == INT64_MIN) return 1;
+
+    long long size;
+    int64_t mtimeNs;
+    long long statStart = statsClock();
+    int ret = statSizeMtime(dirfd, statName, &size, &mtimeNs);
+    statsTime(STAT_STAT, statStart);
+    if (ret != 0) return 0;
+    if (minSize >= 0 && size < minSize) return 0;
+    if (maxSize >= 0 && size > maxSize) return 0;
+    return mtimeNs > newerThanNs;
+}
+
+/* * 递归搜索指定路径下的所有子目录
+ * 如果匹配正则表达式，则将结果写入到指定文件或标准输出
+ * 目录中有 .gitignore 时读取它，被忽略的目录不会被打开，被忽略的文件不会被搜索
+ * 过滤条件按代价从低到高检查：深度在进入子目录之前，扩展名只看文件名，大小和修改时间最后才 statx，
+ * 被排除的文件不会产生任务
+ *
+ * 子目录相对上层目录用 openat 打开，内核不必每次从头解析整条路径
+ *
+ * @param parentFd 上层目录的文件描述符，根目录为 AT_FDCWD
+ * @param dirName 相对 parentFd 的目录名
+ * @param path 目录的完整路径，用于输出和 .gitignore
+ * @param namePattern 文件名模式字符串
+ * @param reg 正则表达式
+ * @param pool 线程池指针
+ * @param parentIgnore 上层目录生效的忽略规则，可以为 NULL
+ * @param depth 递归深度，表示还能深入几层子目录，小于 0 时不再搜索
+ */
+static void traverseDir(int parentFd, const char *dirName, const char *path, char *namePattern, regex_t *reg,
+                        struct ThreadPool *pool, const struct IgnoreList *parentIgnore, int depth)
+{
+    if (depth < 0)
+    {
+        return;
+    }
+
+    long long traverseStart = statsClock();
+    struct DirStream *dir = dirStreamOpen(parentFd, dirName);
+    if (!dir) {
+        printf("[warning] Can not open dir:  %s\n", path);
+        return;
+    }
+    int fd = dirStreamFd(dir);
+    statsCount(STAT_DIRS, 1);
+
+    struct dirItem *items = NULL;
+    size_t count = 0;
+    size_t cap = 0;
+    int hasIgnoreFile = 0;
+    struct DirEntry entry;
+    while (dirStreamRead(dir, &entry) > 0)
+    {
+        unsigned char type = entry.type;
+        // -L 时符号链接按它指向的目标处理，断开的链接和指向其他类型的链接跳过；
+        // 有的文件系统不在目录项里给出类型（DT_UNKNOWN），这时要 stat 一次才知道
+        if (type == DT_UNKNOWN || (followLinks && type == DT_LNK))
+        {
+            struct stat st;
+            if (fstatat(fd, entry.name, &st, followLinks ? 0 : AT_SYMLINK_NOFOLLOW) != 0) continue;
+            type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN;
+        }
+        if (type != DT_DIR && type != DT_REG)
+        {
+            continue;
+        }
+        if (strcmp(entry.name, ".") == 0 || strcmp(entry.name, "..") == 0)
+        {
+            continue;
+        }
+        // 目录项里已经能看到有没有 .gitignore，不用再为每个目录多试一次 open
+        if (type == DT_REG && strcmp(entry.name, ".gitignore") == 0)
+        {
+            hasIgnoreFile = 1;
+        }
+
+        if (count == cap)
+        {
+            cap = cap ? cap * 2 : 64;
+            items = realloc(items, sizeof(struct dirItem) * cap);
+        }
+        items[count].name = strdup(entry.name);
+        items[count].type = type;
+        items[count].ino = entry.ino;
+        count++;
+    }
+
+    if (sortByPath)
+    {
+        qsort(items, count, sizeof(struct dirItem), compareDirItem);
+    }
+    else if (localityOrder != LOCALITY_NONE)
+    {
+        sortByLocality(fd, items, count);
+    }
+    // 只有要读内容时预读才有意义
+    int readAhead = localityOrder != LOCALITY_NONE && (matchContent || indexBuilder != NULL);
+
+    struct IgnoreList *ignore = NULL;
+    if (useIgnore && hasIgnoreFile)
+    {
+        ignore = ignoreLoad(path, parentIgnore);
+    }
+    const struct IgnoreList *rules = ignore ? ignore : parentIgnore;
+    statsTime(STAT_TRAVERSE, traverseStart);
+    // 建索引时总是收录文件，--type 只影响搜索
+    int wantDirs = typeFilter == 'd' && indexBuilder == NULL;
+
+    size_t i = 0;
+    for (; i < count && !atomic_load(&cancelled); i++)
+    {
+        if (items[i].type == DT_DIR)
+        {
+            size_t len = strlen(path) + strlen(items[i].name) + 2; // +2 for '/' and '\0'
+            char *newPath = malloc(len);
+            snprintf(newPath, len, "%s/%s", path, items[i].name);
+            if ((!useIgnore || (strcmp(items[i].name, ".git") != 0 && !ignoreMatch(rules, newPath, items[i].name, 1))) &&
+                firstVisit(fd, items[i].name))
+            {
+                if (wantDirs && statMatches(fd, items[i].name) &&
+                    scheduleFile(newPath, items[i].name, namePattern, reg, pool, 1) != 0)
+                {
+                    free(newPath);
+                    break;
+                }
+                traverseDir(fd, items[i].name, newPath, namePattern, reg, pool, rules, depth - 1);
+            }
+            free(newPath);
+        }
+        else if (!wantDirs && extMatches(items[i].name))
+        {
+            char fullpath[1024];
+            snprintf(fullpath, sizeof(fullpath), "%s/%s", path, items[i].name);
+            if ((!useIgnore || !ignoreMatch(rules, fullpath, items[i].name, 0)) &&
+                statMatches(fd, items[i].name))
+            {
+                if (readAhead) adviseWillNeed(fd, items[i].name);
+                if (scheduleFile(fullpath, items[i].name, namePattern, reg, pool, 0) != 0) break;
+            }
+        }
+        free(items[i].name);
+    }
+    for (; i < count; i++) free(items[i].name);
+    free(items);
+    ignoreFree(ignore);
+    dirStreamClose(dir);
+}
+
+/* * -L 时记录一个目录，已经进入过的目录（链接成环或者重复挂载）返回 0；不跟随链接时总是返回 1
+ *
+ * @param dirfd 上层目录的文件描述符，或 AT_FDCWD
+ * @param name 相对 dirfd 的路径
+ * @return 1 第一次访问，0 已经访问过或者无法获取
+ */
+static int firstVisit(int dirfd, const char *name)
+{
+    if (visited == NULL) return 1;
+    struct stat st;
+    long long statStart = statsClock();
+    int ret = fstatat(dirfd, name, &st, 0);
+    statsTime(STAT_STAT, statStart);
+    if (ret != 0) return 0;
+    return visitedInsert(visited, st.st_dev, st.st_ino);
+}
+
+/* * -L 时记录一个文件，硬链接或多条符号链接指向的同一个文件只扫描一次内容
+ * 文件名不受影响：每个名字都照常匹配和输出，只有内容不再重复扫描
+ *
+ * @param st 文件的 stat 结果
+ * @return 1 第一次扫描这个文件的内容，0 已经扫描过
+ */
+static int firstContentVisit(const struct stat *st)
+{
+    return visited == NULL || visitedInsert(visited, st->st_dev, st->st_ino);
+}
+
+/* * --stats：合计所有线程的计数器并输出
+ * 各阶段的耗时是所有线程加在一起的，线程多时可能超过实际经过的时间
+ *
+ * @param pool 线程池指针
+ * @param queueCap 任务队列的容量
+ * @param wallNs 搜索实际经过的时间（纳秒）
+ */
+void reportStats(struct ThreadPool *pool, int queueCap, long long wallNs)
+{
+    struct Stats total;
+    statsSum(&total);
+    double wall = (wallNs > 0 ? wallNs : 1) / 1e9;
+    double mb = (double)total.count[STAT_BYTES] / (1024 * 1024);
+    printf("[Stats] Dirs: %lld, Files: %lld, Read: %.1f MB, Results: %lld\n",
+           total.count[STAT_DIRS], total.count[STAT_FILES], mb, total.count[STAT_RESULTS]);
+    printf("[Stats] Thread time: traverse %.3fs, stat %.3fs, read %.3fs, match %.3fs, output %.3fs\n",
+           total.ns[STAT_TRAVERSE] / 1e9, total.ns[STAT_STAT] / 1e9, total.ns[STAT_READ] / 1e9,
+           total.ns[STAT_MATCH] / 1e9, total.ns[STAT_OUTPUT] / 1e9);
+    printf("[Stats] Wall time: %.3fs, %.0f files/s, %.1f MB/s, peak queue depth: %d/%d\n",
+           wall, total.count[STAT_FILES] / wall, mb / wall, getThreadQueuePeak(pool), queueCap);
+}
+
+// --max-depth 换算成根目录下还能深入几层子目录
+static int rootDepth(void)
+{
+    return maxDepth < 0 ? INT_MAX : maxDepth - 1;
+}
+
+/* * 递归搜索指定路径下的所有子目录
+ *
+ * @param path 需要搜索的路径
+ * @param namePattern 文件名模式字符串
+ * @param reg 正则表达式
+ * @param pool 线程池指针
+ */
+void traverseAndScheduleSearch(const char *path, char* namePattern, regex_t *reg, struct ThreadPool *pool)
+{
+    firstVisit(AT_FDCWD, path);
+    traverseDir(AT_FDCWD, path, path, namePattern, reg, pool, NULL, rootDepth());
+}
+
+// stat 一个文件，--stats 时计入 stat 的耗时
+static int statFile(const char *path, struct stat *st)
+{
+    long long statStart = statsClock();
+    int ret = stat(path, st);
+    statsTime(STAT_STAT, statStart);
+    return ret;
+}
+
+/* * -i 需要折叠时把文件名折叠到 buf 里，否则直接返回原文件名
+ *
+ * @param name 文件名
+ * @param buf 缓冲区
+ * @param size 缓冲区大小
+ * @return 用来匹配的文件名
+ */
+static const char *foldName(const char *name, char *buf, size_t size)
+{
+    size_t len = strlen(name);
+    if (!foldText || len >= size) return name;
+    foldUtf8(buf, name, len, 1);
+    buf[len] = '\0';
+    return buf;
+}
+
+/* * 目录名匹配函数（--type d）
+ * 只比较目录名，不读取内容
+ *
+ * @param arg 任务体指针
+ */
+static void findDirName(void *arg)
+{
+    struct taskBody *task = (struct taskBody*)arg;
+    struct OutBuf *out = outLocal();
+    char folded[NAME_MAX + 1];
+    const char *name = foldName(task->name, folded, sizeof(folded));
+
+    int matched = 0;
+    const char *hitPattern = NULL;
+    if (patternSet != NULL)
+    {
+        int state = 0;
+        size_t pos = 0;
+        struct AcHit hit;
+        matched = acScan(patternSet, name, strlen(name), &state, &pos, &hit, 1) > 0;
+        if (matched) hitPattern = patternSet->patterns[hit.pattern];
+    }
+    else if (task->reg != NULL)
+    {
+        matched = regexec(task->reg, name, 0, NULL, 0) == 0;
+    }
+    else
+    {
+        matched = matchPattern(name, task->namePattern);
+    }
+
+    if (matched && takeResult())
+    {
+        if (outputFormat == FORMAT_JSON)
+        {
+            reportJson(out, "dir", task->path, hitPattern);
+        }
+        else if (outputFormat == FORMAT_NULL)
+        {
+            outAppendStr(out, task->path);
+            outAppend(out, "\0", 1);
+        }
+        else
+        {
+            outAppendStr(out, "Matched the directory: ");
+            outAppendStr(out, task->path);
+            if (hitPattern)
+            {
+                outAppendStr(out, " [Pattern: ");
+                outAppendStr(out, hitPattern);
+                outAppendStr(out, "]");
+            }
+            outAppendStr(out, "\n");
+        }
+    }
+
+    releasePrefetch(task);
+    finishFile(out, task);
+    free(task->path);
+    free(task->name);
+    free(task);
+}
+
+/* * 模式匹配函数
+ * 利用自定义的模式匹配函数来查找指定路径下的文件
+ * 如果文件名匹配指定的模式，则将结果写入到指定文件或标准输出
+ *
+ * @param arg 任务体指针，包含路径、模式字符串和输出文件指针
+ */
+void findWithPattern(void *arg)
+{
+    struct taskBody *task = (struct taskBody*)arg;
+    char *fullpath = task->path;
+    char *name = task->name;
+    char *namePattern = task->namePattern;
+    struct OutBuf *out = outLocal();
+
+    struct stat st;
+    if (!atomic_load(&cancelled) && statFile(fullpath, &st) == 0 && S_ISREG(st.st_mode))
+    {
+        statsCount(STAT_FILES, 1);
+        char folded[NAME_MAX + 1];
+        int nameMatched = matchPattern(foldName(name, folded, sizeof(folded)), namePattern);
+        // -l 时文件名已经匹配就不必再读内容
+        if (matchContent && !task->skipContent && !(nameMatched && outputMode == OUTPUT_FILES) &&
+            firstContentVisit(&st))
+        {
+            struct lineScanner sc = {0};
+            sc.fullpath = fullpath;
+            sc.out = out;
+            sc.namePattern = namePattern;
+            sc.lit = contentLiteral;
+            // 大文件交给多个线程分块扫描，任务体由最后完成的块释放
+            if (st.st_size > CHUNK_THRESHOLD)
+            {
+                releasePrefetch(task);
+                if (scanInChunks(task, &sc, st.st_size, nameMatched, NULL) == 0) return;
+            }
+            sc.prefetch = task->prefetch;
+
+            if (nameMatched) reportFile(out, fullpath, NULL);
+            scanFileContent(&sc);
+        }
+        else if (nameMatched)
+        {
+            reportFile(out, fullpath, NULL);
+        }
+    }
+
+    releasePrefetch(task);
+    finishFile(out, task);
+    free(task->path);
+    free(task->name);
+    free(task);
+    // usleep(1000);
+    return;
+}
+
+
+/* * 正则表达式匹配函数
+ * 该函数会在一个线程中执行，处理指定路径下的文件
+ * 如果匹配成功，则打印或写入到指定文件
+ *
+ * @param arg 任务体指针，包含路径、正则表达式和输出文件指针
+ */
+void findWithRegex(void *arg)
+{
+    struct taskBody *task = (struct taskBody*)arg;
+    char *fullpath = task->path;
+    char *name = task->name;
+    const regex_t *reg = task->reg;
+    struct OutBuf *out = outLocal();
+
+    struct stat st;
+    if (!atomic_load(&cancelled) && statFile(fullpath, &st) == 0 && S_ISREG(st.st_mode))
+    {
+        statsCount(STAT_FILES, 1);
+        char folded[NAME_MAX + 1];
+        int nameMatched = regexec(reg, foldName(name, folded, sizeof(folded)), 0, NULL, 0) == 0;
+        // -l 时文件名已经匹配就不必再读内容
+        if (matchContent && !task->skipContent && !(nameMatched && outputMode == OUTPUT_FILES) &&
+            firstContentVisit(&st))
+        {
+            struct lineScanner sc = {0};
+            sc.fullpath = fullpath;
+            sc.out = out;
+            sc.reg = reg;
+            sc.lit = contentLiteral;
+            sc.verify = literalPrefilter;
+            // 大文件交给多个线程分块扫描，任务体由最后完成的块释放
+            if (st.st_size > CHUNK_THRESHOLD)
+            {
+                releasePrefetch(task);
+                if (scanInChunks(task, &sc, st.st_size, nameMatched, NULL) == 0) return;
+            }
+            sc.prefetch = task->prefetch;
+
+            if (nameMatched) reportFile(out, fullpath, NULL);
+            scanFileContent(&sc);
+        }
+        else if (nameMatched)
+        {
+            reportFile(out, fullpath, NULL);
+        }
+    }
+
+    releasePrefetch(task);
+    finishFile(out, task);
+    free(task->path);
+    free(task->name);
+    free(task);
+    // usleep(1000);
+    return;
+}
+
+
+/* * 输出当前行的行号
+ * 分块扫描时还不知道这一块之前有多少行，只记下位置，合并结果时再填入
+ *
+ * @param sc 行扫描器
+ * @param out 输出缓冲区
+ */
+static void appendLineno(struct lineScanner *sc, struct OutBuf *out)
+{
+    if (sc->deferLineno)
+    {
+        if (sc->numFixups == sc->fixupsCap)
+        {
+            sc->fixupsCap = sc->fixupsCap ? sc->fixupsCap * 2 : 64;
+            sc->fixups = realloc(sc->fixups, sizeof(struct lineFixup) * sc->fixupsCap);
+        }
+        sc->fixups[sc->numFixups].offset = out->len;
+        sc->fixups[sc->numFixups].lineno = sc->lineno;
+        sc->numFixups++;
+    }
+    else
+    {
+        outAppendInt(out, sc->lineno);
+    }
+}
+
+// 追加一行的内容，行尾统一成一个换行符（文件最后一行可能没有）
+static void appendText(struct OutBuf *out, const char *line, size_t len)
+{
+    if (len > 0 && line[len - 1] == '\n') len--;
+    outAppend(out, line, len);
+    outAppendStr(out, "\n");
+}
+
+/* * 输出一行上下文（-A/-B/-C）
+ * 上下文不占用 --max-count 的额度；分块扫描时不会有上下文，行号直接输出
+ *
+ * @param sc 行扫描器
+ * @param line 行（包含行尾的换行符）
+ * @param len 行长度
+ * @param lineno 行号
+ */
+static void reportContext(struct lineScanner *sc, const char *line, size_t len, int lineno)
+{
+    struct OutBuf *out = sc->out;
+    sc->lastPrinted = lineno;
+    if (outputFormat == FORMAT_JSON)
+    {
+        if (len > 0 && line[len - 1] == '\n') len--;
+        outAppendStr(out, "{\"type\":\"context\",\"path\":");
+        outAppendJson(out, sc->fullpath, strlen(sc->fullpath));
+        outAppendStr(out, ",\"line\":");
+        outAppendInt(out, lineno);
+        outAppendStr(out, ",\"text\":");
+        outAppendJson(out, line, len);
+        outAppendStr(out, "}\n");
+        return;
+    }
+    outAppendStr(out, sc->fullpath);
+    outAppendStr(out, "-");
+    outAppendInt(out, lineno);
+    outAppendStr(out, "-");
+    appendText(out, line, len);
+}
+
+/* * 输出一条内容匹配结果
+ * 正则模式下带列号并用 ^ 指出匹配位置，通配符模式下只输出行号，多模式时还会注明命中的模式
+ * --json 时输出一行 JSON，text 是去掉换行符的整行；带上下文时按 grep -n 的格式输出
+ *
+ * @param sc 行扫描器
+ * @param line 匹配的行（包含行尾的换行符）
+ * @param len 行长度
+ * @param col 匹配开始的列（从 0 开始），-1 表示没有列信息
+ * @param pattern 命中的模式，不是多模式匹配时为 NULL
+ */
+static void reportLine(struct lineScanner *sc, const char *line, size_t len, int col, const char *pattern)
+{
+    struct OutBuf *out = sc->out;
+    if (outputMode == OUTPUT_COUNT)
+    {
+        sc->count++;
+        return;
+    }
+    if (sc->binary || outputMode == OUTPUT_FILES)
+    {
+        sc->matched = 1;
+        sc->stop = 1;
+        return;
+    }
+    int context = contextBefore > 0 || contextAfter > 0;
+    // 带上下文的文本格式每行只输出一次，同一行的其他匹配不再输出
+    if (context && outputFormat == FORMAT_TEXT && sc->lastPrinted == sc->lineno) return;
+    if (!takeResult())
+    {
+        sc->stop = 1;
+        return;
+    }
+    sc->lastPrinted = sc->lineno;
+    sc->afterLeft = contextAfter;
+    if (outputFormat == FORMAT_JSON)
+    {
+        if (len > 0 && line[len - 1] == '\n') len--;
+        outAppendStr(out, "{\"type\":\"match\",\"path\":");
+        outAppendJson(out, sc->fullpath, strlen(sc->fullpath));
+        outAppendStr(out, ",\"line\":");
+        appendLineno(sc, out);
+        if (col >= 0)
+        {
+            outAppendStr(out, ",\"col\":");
+            outAppendInt(out, col + 1);
+        }
+        if (pattern)
+        {
+            outAppendStr(out, ",\"pattern\":");
+            outAppendJson(out, pattern, strlen(pattern));
+        }
+        outAppendStr(out, ",\"text\":");
+        outAppendJson(out, line, len);
+        outAppendStr(out, "}\n");
+        return;
+    }
+    if (context)
+    {
+        // 与 grep -n 的格式相同：匹配行用 ':'，上下文行用 '-'
+        outAppendStr(out, sc->fullpath);
+        outAppendStr(out, ":");
+        appendLineno(sc, out);
+        outAppendStr(out, ":");
+        appendText(out, line, len);
+        return;
+    }
+    outAppendStr(out, "Matched in file: ");
+    outAppendStr(out, sc->fullpath);
+    outAppendStr(out, "\n=> ");
+    outAppend(out, line, len);
+    outAppendStr(out, " [Line ");
+    appendLineno(sc, out);
+    if (col < 0)
+    {
+        outAppendStr(out, "]\n\n");
+        return;
+    }
+
+    outAppendStr(out, ", Col ");
+    outAppendInt(out, col + 1);
+    if (pattern)
+    {
+        outAppendStr(out, ", Pattern: ");
+        outAppendStr(out, pattern);
+    }
+    outAppendStr(out, "]\n   ");
+    outAppendRepeat(out, ' ', (size_t)col);
+    outAppendStr(out, "^\n");
+}
+
+/* * 一个文件处理完毕
+ * 有序模式下把这个文件的结果交给重排缓冲区，否则留在线程缓冲区里攒批写出
+ *
+ * @param out 当前线程的输出缓冲区，其中只有这个文件的结果
+ * @param task 任务体
+ */
+static void finishFile(struct OutBuf *out, struct taskBody *task)
+{
+    long long outputStart = statsClock();
+    if (reorder)
+    {
+        reorderSubmit(reorder, task->seq, out->data, out->len);
+        out->len = 0;
+    }
+    else
+    {
+        outFileDone(out);
+    }
+    statsTime(STAT_OUTPUT, outputStart);
+}
+
+/* * io_uring 读完一个文件的第一块，在 I/O 线程中调用
+ * 把预读结果挂到任务体上，再把任务加入线程池
+ *
+ * @param arg 任务体
+ * @param pf 预读结果
+ */
+void prefetchReady(void *arg, struct IoPrefetch *pf)
+{
+    struct taskBody *task = arg;
+    task->prefetch = pf;
+    int ret = ThreadPoolAdd(task->pool, task->func, task);
+    if (ret != 0)
+    {
+        printf("[Error] Fail to add task to thread pool: %d\n", ret);
+        if (reorder) reorderSubmit(reorder, task->seq, NULL, 0);
+        releasePrefetch(task);
+        free(task->path);
+        free(task->name);
+        free(task);
+    }
+}
+
+// 归还 io_uring 预读的缓冲区，没有预读时什么也不做
+static void releasePrefetch(struct taskBody *task)
+{
+    if (task->prefetch == NULL) return;
+    ioRingRelease(ioRing, task->prefetch);
+    task->prefetch = NULL;
+}
+
+/* * 等待所有已经调度的文件搜索完毕
+ * 使用 io_uring 时任务先要从 I/O 线程转交到线程池，所以先等 I/O 线程交完，再等线程池空闲
+ *
+ * @param pool 线程池指针
+ */
+void waitForSearch(struct ThreadPool *pool)
+{
+    if (ioRing) ioRingWait(ioRing);
+    ThreadPoolWait(pool);
+}
+
+/* * 输出一条文件名匹配结果
+ *
+ * @param out 输出缓冲区
+ * @param fullpath 文件路径
+ * @param pattern 命中的模式，不是多模式匹配时为 NULL
+ */
+static void reportFile(struct OutBuf *out, const char *fullpath, const char *pattern)
+{
+    // --replace 只改写内容，文件名匹配不输出
+    if (replaceText) return;
+    if (!takeResult()) return;
+    if (outputFormat == FORMAT_JSON)
+    {
+        reportJson(out, "file", fullpath, pattern);
+        return;
+    }
+    if (outputMode == OUTPUT_FILES)
+    {
+        outAppendStr(out, fullpath);
+        outAppend(out, outputFormat == FORMAT_NULL ? "\0" : "\n", 1);
+        return;
+    }
+    outAppendStr(out, "Matched the file: ");
+    outAppendStr(out, fullpath);
+    if (pattern)
+    {
+        outAppendStr(out, " [Pattern: ");
+        outAppendStr(out, pattern);
+        outAppendStr(out, "]");
+    }
+    outAppendStr(out, "\n");
+}
+
+/* * 输出一条只有路径的 JSON 结果：文件名或目录名匹配、-l、二进制文件匹配
+ *
+ * @param out 输出缓冲区
+ * @param type 结果类型
+ * @param path 路径
+ * @param pattern 命中的模式，没有时为 NULL
+ */
+static void reportJson(struct OutBuf *out, const char *type, const char *path, const char *pattern)
+{
+    outAppendStr(out, "{\"type\":\"");
+    outAppendStr(out, type);
+    outAppendStr(out, "\",\"path\":");
+    outAppendJson(out, path, strlen(path));
+    if (pattern)
+    {
+        outAppendStr(out, ",\"pattern\":");
+        outAppendJson(out, pattern, strlen(pattern));
+    }
+    outAppendStr(out, "}\n");
+}
+
+/* * 从 --max-count 的额度中取出一条结果
+ * 取走最后一条时就置位 cancelled，让其他线程尽早停下
+ *
+ * @return 1 可以输出，0 额度已经用完
+ */
+static int takeResult(void)
+{
+    if (maxCount >= 0)
+    {
+        long long left = atomic_fetch_sub(&resultBudget, 1);
+        if (left <= 1) atomic_store(&cancelled, 1);
+        if (left <= 0) return 0;
+    }
+    statsCount(STAT_RESULTS, 1);
+    return 1;
+}
+
+/* * 整个文件扫描完之后的汇总输出：-l 的文件路径、--count 的行数、二进制文件的匹配提示
+ *
+ * @param out 输出缓冲区
+ * @param fullpath 文件路径
+ * @param matched 是否有匹配（-l 和二进制文件）
+ * @param count 匹配的行数（--count）
+ */
+static void reportSummary(struct OutBuf *out, const char *fullpath, int matched, long long count)
+{
+    if (outputMode == OUTPUT_COUNT)
+    {
+        if (count == 0 || !takeResult()) return;
+        if (outputFormat == FORMAT_JSON)
+        {
+            outAppendStr(out, "{\"type\":\"count\",\"path\":");
+            outAppendJson(out, fullpath, strlen(fullpath));
+            outAppendStr(out, ",\"count\":");
+            outAppendInt(out, count);
+            outAppendStr(out, "}\n");
+            return;
+        }
+        // --null 时路径后面是 '\0' 而不是 ':'，与 grep -cZ 相同
+        outAppendStr(out, fullpath);
+        outAppend(out, outputFormat == FORMAT_NULL ? "\0" : ":", 1);
+        outAppendInt(out, count);
+        outAppendStr(out, "\n");
+        return;
+    }
+    if (!matched) return;
+    if (outputMode == OUTPUT_FILES)
+    {
+        reportFile(out, fullpath, NULL);
+        return;
+    }
+    if (!takeResult()) return;
+    if (outputFormat == FORMAT_JSON)
+    {
+        reportJson(out, "binary", fullpath, NULL);
+        return;
+    }
+    outAppendStr(out, "Binary file ");
+    outAppendStr(out, fullpath);
+    outAppendStr(out, " matches\n");
+}
+
+// 把一段数据追加到 buf 中，容量不够时扩容
+static void appendBytes(char **buf, size_t *len, size_t *cap, const char *data, size_t n)
+{
+    if (*len + n + 1 > *cap)
+    {
+        size_t newCap = *cap ? *cap : 256;
+        while (newCap < *len + n + 1) newCap *= 2;
+        *buf = realloc(*buf, newCap);
+        *cap = newCap;
+    }
+    memcpy(*buf + *len, data, n);
+    *len += n;
+}
+
+/* * 把一行复制到 scratch 并以 '\0' 结尾，-i 需要折叠时顺便折叠
+ *
+ * @param sc 行扫描器
+ * @param line 行
+ * @param len 长度
+ */
+static void copyToScratch(struct lineScanner *sc, const char *line, size_t len)
+{
+    size_t used = 0;
+    appendBytes(&sc->scratch, &used, &sc->scratchCap, line, len);
+    sc->scratch[len] = '\0';
+    if (foldText) foldUtf8(sc->scratch, sc->scratch, len, 1);
+}
+
+/* * 用正则或通配符判断一行是否匹配
+ * 行先被复制成 '\0' 结尾的字符串，保持与按行读取时相同的匹配语义
+ *
+ * @param sc 行扫描器
+ * @param line 行（包含行尾的换行符）
+ * @param len 行长度
+ * @param col 输出：匹配开始的列，通配符模式下为 -1
+ * @return 1 匹配，0 不匹配
+ */
+static int matchLine(struct lineScanner *sc, const char *line, size_t len, int *col)
+{
+    copyToScratch(sc, line, len);
+
+    if (sc->reg)
+    {
+        regmatch_t match[1];
+        if (regexec(sc->reg, sc->scratch, 1, match, 0) != 0) return 0;
+        *col = (int)match[0].rm_so;
+        return 1;
+    }
+
+    *col = -1;
+    return matchPattern(sc->scratch, sc->namePattern);
+}
+
+/* * 从 end（某一行的开头）往回数最多 n 行
+ *
+ * @param start 缓冲区开头，也是一行的开头
+ * @param end 往回数的起点
+ * @param n 最多数几行
+ * @param got 输出：实际数到的行数
+ * @return 数到的最早一行的开头
+ */
+static const char *backLines(const char *start, const char *end, int n, int *got)
+{
+    *got = 0;
+    while (*got < n && end > start)
+    {
+        end--; // 上一行的换行符
+        while (end > start && end[-1] != '\n') end--;
+        (*got)++;
+    }
+    return end;
+}
+
+// 把 [p, end) 中的每一行作为上下文输出，第一行的行号是 lineno
+static void reportContextLines(struct lineScanner *sc, const char *p, const char *end, int lineno)
+{
+    while (p < end)
+    {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        const char *lineEnd = nl ? nl + 1 : end;
+        reportContext(sc, p, (size_t)(lineEnd - p), lineno++);
+        p = lineEnd;
+    }
+}
+
+/* * 跳过一段没有匹配的完整行
+ * 上一个匹配行的后文（-A）还没输出完时，从这段的开头接着输出
+ *
+ * @param sc 行扫描器，lineno 是 p 之前的行数
+ * @param p 第一行的开头
+ * @param end 这一段的结尾
+ */
+static void skipLines(struct lineScanner *sc, const char *p, const char *end)
+{
+    while (sc->afterLeft > 0 && p < end)
+    {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        const char *lineEnd = nl ? nl + 1 : end;
+        sc->lineno++;
+        sc->afterLeft--;
+        reportContext(sc, p, (size_t)(lineEnd - p), sc->lineno);
+        p = lineEnd;
+    }
+    sc->lineno += (int)countByte(p, (size_t)(end - p), '\n');
+}
+
+/* * 在输出匹配行之前输出它的前文（-B），与上一组不相邻时先输出一行 "--"
+ * 文件中的第一组也带 "--"，与 grep 一样把它和之前其他文件的结果隔开；整个输出开头的那个由 outDropLeading 去掉
+ * 前文先在当前缓冲区里往回找，不够时再从 history 中取，已经输出过的行不再输出
+ *
+ * @param sc 行扫描器，lineno 是匹配行的行号
+ * @param buf 当前缓冲区的开头
+ * @param lineStart 匹配行的开头
+ */
+static void beginMatch(struct lineScanner *sc, const char *buf, const char *lineStart)
+{
+    if ((contextBefore == 0 && contextAfter == 0) || sc->binary || atomic_load(&cancelled)) return;
+
+    int want = sc->lineno - 1 - sc->lastPrinted;
+    if (want > contextBefore) want = contextBefore;
+    int inBuf = 0;
+    int inHistory = 0;
+    const char *from = backLines(buf, lineStart, want, &inBuf);
+    const char *historyEnd = sc->history + sc->historyLen;
+    const char *historyFrom = historyEnd;
+    if (inBuf < want) historyFrom = backLines(sc->history, historyEnd, want - inBuf, &inHistory);
+
+    int first = sc->lineno - inBuf - inHistory;
+    if (outputFormat == FORMAT_TEXT && (sc->lastPrinted == 0 || first > sc->lastPrinted + 1))
+    {
+        outAppendStr(sc->out, "--\n");
+    }
+    reportContextLines(sc, historyFrom, historyEnd, first);
+    reportContextLines(sc, from, lineStart, first + inHistory);
+}
+
+/* * 一段缓冲区扫描完之后，记住它末尾的 contextBefore 行
+ * 下一段缓冲区开头的几行如果匹配，前文就在这里；这一段不够 contextBefore 行时连同之前的历史一起保留
+ *
+ * @param sc 行扫描器
+ * @param buf 缓冲区，只包含完整的行
+ * @param len 缓冲区长度
+ */
+static void keepHistory(struct lineScanner *sc, const char *buf, size_t len)
+{
+    if (contextBefore == 0) return;
+    int got;
+    const char *from = backLines(buf, buf + len, contextBefore, &got);
+    size_t keep = 0;
+    if (got < contextBefore && sc->historyLen > 0)
+    {
+        int kept;
+        const char *historyEnd = sc->history + sc->historyLen;
+        const char *historyFrom = backLines(sc->history, historyEnd, contextBefore - got, &kept);
+        keep = (size_t)(historyEnd - historyFrom);
+        memmove(sc->history, historyFrom, keep);
+    }
+    sc->historyLen = keep;
+    appendBytes(&sc->history, &sc->historyLen, &sc->historyCap, from, (size_t)(buf + len - from));
+}
+
+/* * 输出一个匹配行
+ * --all-matches 时从行首接着往后找，一行中的每个匹配各输出一条（空匹配只算第一个），
+ * 没有列信息的通配符模式仍然只输出一条
+ *
+ * @param sc 行扫描器，正则模式下 scratch 中是 matchLine 复制好的这一行
+ * @param line 行（包含行尾的换行符）
+ * @param len 行长度
+ * @param col 第一个匹配的列，-1 表示没有列信息
+ */
+static void reportMatches(struct lineScanner *sc, const char *line, size_t len, int col)
+{
+    if (!allMatches || col < 0)
+    {
+        reportLine(sc, line, len, col, NULL);
+        return;
+    }
+
+    if (sc->lit && !sc->verify)
+    {
+        const char *end = line + len;
+        const char *hit = line + col;
+        while (hit != NULL && !sc->stop)
+        {
+            reportLine(sc, line, len, (int)(hit - line), NULL);
+            hit += sc->lit->len;
+            hit = literalFind(sc->lit, hit, (size_t)(end - hit));
+        }
+        return;
+    }
+
+    regmatch_t match[1];
+    size_t off = 0;
+    int flags = 0;
+    while (!sc->stop && off <= len && regexec(sc->reg, sc->scratch + off, 1, match, flags) == 0)
+    {
+        if (flags == 0 || match[0].rm_eo > match[0].rm_so)
+        {
+            reportLine(sc, line, len, (int)(off + match[0].rm_so), NULL);
+        }
+        // 空匹配时至少前进一个字节，否则会停在原地
+        off += match[0].rm_eo > match[0].rm_so ? (size_t)match[0].rm_eo : (size_t)match[0].rm_so + 1;
+        flags = REG_NOTBOL;
+    }
+}
+
+/* * 用多模式自动机在一段完整的行上做匹配
+ * 自动机找到第一个命中后确定所在行，再把这一行扫完，每个模式在一行中只报告第一次出现的位置
+ * （--all-matches 时报告每一次出现）
+ *
+ * @param sc 行扫描器
+ * @param buf 缓冲区，只包含完整的行
+ * @param len 缓冲区长度
+ */
+static void scanLinesWithPatternSet(struct lineScanner *sc, const char *buf, size_t len)
+{
+    const char *p = buf;
+    const char *end = buf + len;
+    struct AcHit hits[MAX_LINE_HITS];
+
+    while (p < end)
+    {
+        int state = 0;
+        size_t pos = 0;
+        int n = acScan(sc->ac, p, (size_t)(end - p), &state, &pos, hits, MAX_LINE_HITS);
+        if (n == 0)
+        {
+            skipLines(sc, p, end);
+            return;
+        }
+
+        // 模式中不会有换行符，同一位置结束的命中都在同一行
+        const char *hit = p + hits[0].start;
+        const char *lineStart = hit;
+        while (lineStart > p && lineStart[-1] != '\n') lineStart--;
+        skipLines(sc, p, lineStart);
+        sc->lineno++;
+        const char *nl = memchr(hit, '\n', (size_t)(end - hit));
+        const char *lineEnd = nl ? nl + 1 : end;
+        size_t lineLen = (size_t)(lineEnd - lineStart);
+        beginMatch(sc, buf, lineStart);
+
+        int found[MAX_LINE_HITS];
+        int cols[MAX_LINE_HITS];
+        int numFound = 0;
+        do
+        {
+            for (int i = 0; i < n; i++)
+            {
+                // --all-matches：每个命中都直接输出，不按模式去重
+                if (allMatches)
+                {
+                    reportLine(sc, lineStart, lineLen, (int)(p + hits[i].start - lineStart),
+                               sc->ac->patterns[hits[i].pattern]);
+                    if (sc->stop) return;
+                    continue;
+                }
+                int seen = 0;
+                for (int j = 0; j < numFound; j++)
+                {
+                    if (found[j] == hits[i].pattern) seen = 1;
+                }
+                if (!seen && numFound < MAX_LINE_HITS)
+                {
+                    found[numFound] = hits[i].pattern;
+                    cols[numFound] = (int)(p + hits[i].start - lineStart);
+                    numFound++;
+                }
+            }
+            n = acScan(sc->ac, p, (size_t)(lineEnd - p), &state, &pos, hits, MAX_LINE_HITS);
+        } while (n > 0);
+
+        for (int i = 0; i < numFound && !sc->stop; i++)
+        {
+            reportLine(sc, lineStart, lineLen, cols[i], sc->ac->patterns[found[i]]);
+        }
+        if (sc->stop) return;
+        p = lineEnd;
+    }
+}
+
+/* * 在一段完整的行上做匹配
+ * 字面量模式下直接在整段缓冲区里查找，命中后再回头确定所在行和行号，
+ * 如果字面量只是预过滤条件，命中的行再用正则确认；其他模式逐行交给 matchLine
+ *
+ * @param sc 行扫描器
+ * @param buf 缓冲区，只包含完整的行（文件最后一行可以没有换行符）
+ * @param len 缓冲区长度
+ */
+static void scanLines(struct lineScanner *sc, const char *buf, size_t len)
+{
+    const char *p = buf;
+    const char *end = buf + len;
+
+    if (sc->ac)
+    {
+        scanLinesWithPatternSet(sc, buf, len);
+        return;
+    }
+
+    if (sc->lit)
+    {
+        while (p < end)
+        {
+            const char *hit = literalFind(sc->lit, p, (size_t)(end - p));
+            if (hit == NULL)
+            {
+                skipLines(sc, p, end);
+                return;
+            }
+
+            const char *lineStart = hit;
+            while (lineStart > p && lineStart[-1] != '\n') lineStart--;
+            skipLines(sc, p, lineStart);
+
+            const char *nl = memchr(hit, '\n', (size_t)(end - hit));
+            const char *lineEnd = nl ? nl + 1 : end;
+            size_t lineLen = (size_t)(lineEnd - lineStart);
+            int col = sc->reg ? (int)(hit - lineStart) : -1;
+            if (!sc->verify || matchLine(sc, lineStart, lineLen, &col))
+            {
+                sc->lineno++;
+                beginMatch(sc, buf, lineStart);
+                reportMatches(sc, lineStart, lineLen, col);
+                if (sc->stop) return;
+            }
+            else
+            {
+                // 含有字面量但正则不匹配的行，和其他不匹配的行一样处理
+                skipLines(sc, lineStart, lineEnd);
+            }
+            p = lineEnd;
+        }
+        return;
+    }
+
+    while (p < end)
+    {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        const char *lineEnd = nl ? nl + 1 : end;
+        size_t lineLen = (size_t)(lineEnd - p);
+        int col;
+        if (matchLine(sc, p, lineLen, &col))
+        {
+            sc->lineno++;
+            beginMatch(sc, buf, p);
+            reportMatches(sc, p, lineLen, col);
+            if (sc->stop) return;
+        }
+        else
+        {
+            skipLines(sc, p, lineEnd);
+        }
+        p = lineEnd;
+    }
+}
+
+// 处理一段完整的行
+typedef void (*LinesFunc)(void *ctx, const char *buf, size_t len);
+
+/* * 把一块数据按完整的行交给 lines
+ * 先补齐上一块残留的半行，再处理本块中所有完整的行，最后把本块末尾的半行留给下一块
+ *
+ * @param sc 行扫描器，保存跨块的半行
+ * @param data 数据
+ * @param len 数据长度
+ * @param lines 处理完整行的函数
+ * @param ctx 传给 lines 的参数
+ */
+static void feedLines(struct lineScanner *sc, const char *data, size_t len, LinesFunc lines, void *ctx)
+{
+    if (sc->carryLen > 0)
+    {
+        const char *nl = memchr(data, '\n', len);
+        size_t take = nl ? (size_t)(nl - data) + 1 : len;
+        appendBytes(&sc->carry, &sc->carryLen, &sc->carryCap, data, take);
+        if (nl == NULL) return;
+
+        lines(ctx, sc->carry, sc->carryLen);
+        sc->carryLen = 0;
+        data += take;
+        len -= take;
+        if (sc->stop) return;
+    }
+
+    size_t whole = len;
+    while (whole > 0 && data[whole - 1] != '\n') whole--;
+    if (whole > 0) lines(ctx, data, whole);
+    if (whole < len) appendBytes(&sc->carry, &sc->carryLen, &sc->carryCap, data + whole, len - whole);
+}
+
+// 匹配一段完整的行，再记住它末尾的几行作为下一段的前文
+static void scanBlock(void *ctx, const char *buf, size_t len)
+{
+    struct lineScanner *sc = ctx;
+    scanLines(sc, buf, len);
+    keepHistory(sc, buf, len);
+}
+
+// 向行扫描器喂入一块数据
+static void scannerFeed(struct lineScanner *sc, const char *data, size_t len)
+{
+    long long matchStart = statsClock();
+    feedLines(sc, data, len, scanBlock, sc);
+    statsTime(STAT_MATCH, matchStart);
+}
+
+// 每个工作线程一块读缓冲区，线程退出时释放
+static pthread_key_t readBufKey;
+static pthread_once_t readBufOnce = PTHREAD_ONCE_INIT;
+
+static void createReadBufKey(void)
+{
+    pthread_key_create(&readBufKey, free);
+}
+
+// 获取当前线程的读缓冲区（READ_BUF_SIZE 字节），第一次调用时分配
+static char *threadReadBuf(void)
+{
+    pthread_once(&readBufOnce, createReadBufKey);
+    char *buf = pthread_getspecific(readBufKey);
+    if (buf == NULL)
+    {
+        buf = malloc(READ_BUF_SIZE);
+        pthread_setspecific(readBufKey, buf);
+    }
+    return buf;
+}
+
+/* * 读一块文件内容，--stats 时计入读取的耗时和字节数
+ *
+ * @param fd 文件描述符
+ * @param buf 缓冲区，大小为 READ_BUF_SIZE
+ * @param pos 读取的位置，小于 0 时从当前位置顺序读
+ * @return 读到的字节数，0 表示文件结束，-1 表示出错
+ */
+static ssize_t readBlock(int fd, char *buf, off_t pos)
+{
+    long long readStart = statsClock();
+    ssize_t n = pos < 0 ? read(fd, buf, READ_BUF_SIZE) : pread(fd, buf, READ_BUF_SIZE, pos);
+    statsTime(STAT_READ, readStart);
+    if (n > 0) statsCount(STAT_BYTES, n);
+    return n;
+}
+
+/* * 根据文件开头的内容判断是不是二进制文件
+ * 含有 NUL 字节，或者以 UTF-16/UTF-32 的 BOM 开头（按字节匹配不出东西）都算二进制
+ *
+ * @param buf 文件开头的数据
+ * @param len 数据长度
+ * @return 1 是二进制文件，0 当作文本
+ */
+static int looksBinary(const char *buf, size_t len)
+{
+    const unsigned char *p = (const unsigned char*)buf;
+    if (len >= 2 && ((p[0] == 0xFF && p[1] == 0xFE) || (p[0] == 0xFE && p[1] == 0xFF))) return 1;
+    return memchr(buf, '\0', len < BINARY_SNIFF_SIZE ? len : BINARY_SNIFF_SIZE) != NULL;
+}
+
+/* * 解压出一块数据，交给行扫描器
+ * 解压出的第一块用来判断是不是二进制文件（例如 .tar.gz），按 --binary 处理
+ *
+ * @param ctx 行扫描器
+ * @param data 解压出的数据
+ * @param len 长度
+ * @return 非0 表示不必再解压
+ */
+static int scanDecompressed(void *ctx, const char *data, size_t len)
+{
+    struct lineScanner *sc = ctx;
+    if (!sc->sniffed)
+    {
+        sc->sniffed = 1;
+        if (binaryPolicy != BINARY_TEXT && looksBinary(data, len))
+        {
+            if (binaryPolicy == BINARY_SKIP)
+            {
+                sc->stop = 1;
+                return 1;
+            }
+            sc->binary = 1;
+        }
+    }
+    scannerFeed(sc, data, len);
+    return sc->stop || atomic_load(&cancelled);
+}
+
+// --replace 改写一个文件时的状态
+struct replaceState
+{
+    struct lineScanner *sc;   // 匹配设置、行号、跨块的半行都沿用行扫描器
+    const char *target;       // 要改写的文件，-L 时是链接指向的真实路径
+    int src;
+    int tmp;                  // 临时文件，第一次替换时才创建，-1 表示还没有
+    char tmpPath[PATH_MAX];
+    off_t offset;             // 源文件中已经处理过的字节数，总是一行的开头
+    long long replaced;       // 替换的次数
+    int lineDelta;            // --dry-run：新文件与原文件的行号之差
+    int diffStarted;          // --dry-run：已经输出过 diff 的文件头
+    int failed;
+    char *pending;            // 还没写入临时文件的内容
+    size_t pendingLen;
+    size_t pendingCap;
+    char *line;               // 替换后的当前行
+    size_t lineLen;
+    size_t lineCap;
+    struct AcHit *hits;       // 多模式：一行中的所有命中
+    size_t numHits;
+    size_t hitsCap;
+};
+
+// 写出全部数据，被信号打断时继续写
+static int writeAll(int fd, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = write(fd, data, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// 把攒下的内容写入临时文件
+static void flushPending(struct replaceState *rs)
+{
+    if (rs->pendingLen > 0 && writeAll(rs->tmp, rs->pending, rs->pendingLen) != 0) rs->failed = 1;
+    rs->pendingLen = 0;
+}
+
+// 原样保留一段内容：临时文件还没创建时什么都不用做，之后由 openTemp 从源文件整段复制
+static void keepBytes(struct replaceState *rs, const char *data, size_t len)
+{
+    if (rs->tmp < 0) return;
+    appendBytes(&rs->pending, &rs->pendingLen, &rs->pendingCap, data, len);
+    if (rs->pendingLen >= READ_BUF_SIZE) flushPending(rs);
+}
+
+/* * 在要改写的文件旁边创建临时文件，并复制第一个被替换的行之前的内容
+ * 临时文件和原文件在同一个目录中，rename 才是原子的
+ *
+ * @param rs 改写状态，offset 是第一个被替换的行的开头
+ * @return 0 成功，-1 失败
+ */
+static int openTemp(struct replaceState *rs)
+{
+    snprintf(rs->tmpPath, sizeof(rs->tmpPath), "%s.pfind-XXXXXX", rs->target);
+    rs->tmp = mkstemp(rs->tmpPath);
+    if (rs->tmp < 0) return -1;
+
+    char *copy = malloc(READ_BUF_SIZE);
+    if (copy == NULL) return -1;
+    off_t pos = 0;
+    while (pos < rs->offset)
+    {
+        size_t want = rs->offset - pos < READ_BUF_SIZE ? (size_t)(rs->offset - pos) : READ_BUF_SIZE;
+        ssize_t n = pread(rs->src, copy, want, pos);
+        if (n <= 0 || writeAll(rs->tmp, copy, (size_t)n) != 0) break;
+        pos += n;
+    }
+    free(copy);
+    return pos == rs->offset ? 0 : -1;
+}
+
+/* * 追加替换的内容
+ * \0 到 \9 引用匹配的整体和分组（不存在或没有参与匹配的分组为空），\\ 是反斜杠，其他字符原样输出
+ *
+ * @param rs 改写状态
+ * @param subject 匹配所在的文本，match 中的偏移相对于它
+ * @param match 匹配的整体和分组
+ * @param nmatch match 中的元素个数
+ */
+static void appendReplacement(struct replaceState *rs, const char *subject, const regmatch_t *match, int nmatch)
+{
+    if (!replaceRefs)
+    {
+        appendBytes(&rs->line, &rs->lineLen, &rs->lineCap, replaceText, replaceLen);
+        return;
+    }
+    for (const char *p = replaceText; *p; p++)
+    {
+        if (*p == '\\' && p[1] >= '0' && p[1] <= '9')
+        {
+            int g = p[1] - '0';
+            if (g < nmatch && match[g].rm_so >= 0)
+            {
+                appendBytes(&rs->line, &rs->lineLen, &rs->lineCap, subject + match[g].rm_so,
+                            (size_t)(match[g].rm_eo - match[g].rm_so));
+            }
+            p++;
+            continue;
+        }
+        if (*p == '\\' && p[1] == '\\') p++;
+        appendBytes(&rs->line, &rs->lineLen, &rs->lineCap, p, 1);
+    }
+}
+
+// 多模式命中按起始位置排序，同一位置长的在前
+static int compareHit(const void *a, const void *b)
+{
+    const struct AcHit *x = a;
+    const struct AcHit *y = b;
+    if (x->start != y->start) return x->start < y->start ? -1 : 1;
+    return (int)patternSet->patternLens[y->pattern] - (int)patternSet->patternLens[x->pattern];
+}
+
+/* * 替换一行中的所有匹配，结果放在 rs->line
+ * 行尾的换行符不参与匹配；空匹配之后至少前进一个字节，紧跟在上一个匹配后面的空匹配不算
+ *
+ * @param rs 改写状态
+ * @param line 行（包含行尾的换行符）
+ * @param len 行长度
+ * @return 替换的次数，0 表示这一行不变
+ */
+static long long substituteLine(struct replaceState *rs, const char *line, size_t len)
+{
+    struct lineScanner *sc = rs->sc;
+    size_t body = len > 0 && line[len - 1] == '\n' ? len - 1 : len;
+    size_t done = 0; // line 中已经处理过的字节数
+    long long n = 0;
+    rs->lineLen = 0;
+
+    if (sc->ac)
+    {
+        // 自动机按结束位置报告命中，先收集整行的命中，再从左到右挑出互不重叠的匹配
+        int state = 0;
+        size_t pos = 0;
+        struct AcHit hits[MAX_LINE_HITS];
+        int k;
+        rs->numHits = 0;
+        while ((k = acScan(sc->ac, line, body, &state, &pos, hits, MAX_LINE_HITS)) > 0)
+        {
+            if (rs->numHits + (size_t)k > rs->hitsCap)
+            {
+                rs->hitsCap = rs->hitsCap ? rs->hitsCap * 2 : MAX_LINE_HITS * 2;
+                rs->hits = realloc(rs->hits, sizeof(struct AcHit) * rs->hitsCap);
+            }
+            memcpy(rs->hits + rs->numHits, hits, sizeof(struct AcHit) * (size_t)k);
+            rs->numHits += (size_t)k;
+        }
+        qsort(rs->hits, rs->numHits, sizeof(struct AcHit), compareHit);
+        for (size_t i = 0; i < rs->numHits; i++)
+        {
+            if (rs->hits[i].start < done) continue;
+            regmatch_t match = {.rm_so = (regoff_t)rs->hits[i].start,
+                                .rm_eo = (regoff_t)(rs->hits[i].start + sc->ac->patternLens[rs->hits[i].pattern])};
+            appendBytes(&rs->line, &rs->lineLen, &rs->lineCap, line + done, rs->hits[i].start - done);
+            appendReplacement(rs, line, &match, 1);
+            done = (size_t)match.rm_eo;
+            n++;
+        }
+    }
+    else if (sc->lit && !sc->verify)
+    {
+        const char *end = line + body;
+        const char *p = line;
+        const char *hit;
+        while ((hit = literalFind(sc->lit, p, (size_t)(end - p))) != NULL)
+        {
+            regmatch_t match = {.rm_so = (regoff_t)(hit - line), .rm_eo = (regoff_t)(hit - line + sc->lit->len)};
+            appendBytes(&rs->line, &rs->lineLen, &rs->lineCap, p, (size_t)(hit - p));
+            appendReplacement(rs, line, &match, 1);
+            p = hit + sc->lit->len;
+            n++;
+        }
+        done = (size_t)(p - line);
+    }
+    else
+    {
+        // 字面量是正则的必需字符串时，先用它排除不可能匹配的行
+        if (sc->lit && literalFind(sc->lit, line, body) == NULL) return 0;
+        copyToScratch(sc, line, body);
+
+        regmatch_t match[10];
+        size_t off = 0;
+        size_t lastEnd = (size_t)-1; // 上一个非空匹配的结尾
+        int flags = 0;
+        while (off <= body && regexec(sc->reg, sc->scratch + off, 10, match, flags) == 0)
+        {
+            size_t so = off + (size_t)match[0].rm_so;
+            size_t eo = off + (size_t)match[0].rm_eo;
+            flags = REG_NOTBOL;
+            // 紧跟在上一个匹配后面的空匹配不算，与 sed 相同
+            if (eo > so || so != lastEnd)
+            {
+                appendBytes(&rs->line, &rs->lineLen, &rs->lineCap, line + done, so - done);
+                // 捕获组从原文取，-i 折叠过的 scratch 会丢掉原来的大小写
+                appendReplacement(rs, line + off, match, 10);
+                n++;
+                done = eo;
+            }
+            if (eo > so)
+            {
+                off = eo;
+                lastEnd = eo;
+                continue;
+            }
+            // 空匹配之后原样复制一个字节再接着找
+            if (so < body) appendBytes(&rs->line, &rs->lineLen, &rs->lineCap, line + so, 1);
+            off = so + 1;
+            done = off < body ? off : body;
+        }
+    }
+
+    if (n > 0) appendBytes(&rs->line, &rs->lineLen, &rs->lineCap, line + done, len - done);
+    return n;
+}
+
+// 给每一行加上前缀 c；最后一行没有换行符时按 diff 的习惯注明
+static void appendDiffLines(struct OutBuf *out, char c, const char *text, size_t len)
+{
+    const char *p = text;
+    const char *end = text + len;
+    while (p < end)
+    {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        const char *lineEnd = nl ? nl + 1 : end;
+        outAppend(out, &c, 1);
+        outAppend(out, p, (size_t)(lineEnd - p));
+        if (nl == NULL) outAppendStr(out, "\n\\ No newline at end of file\n");
+        p = lineEnd;
+    }
+}
+
+/* * --dry-run：把一行的改动输出成统一格式的 diff，可以直接交给 patch
+ *
+ * @param rs 改写状态，rs->line 是替换后的行
+ * @param line 原来的行
+ * @param len 长度
+ */
+static void reportDiff(struct replaceState *rs, const char *line, size_t len)
+{
+    struct lineScanner *sc = rs->sc;
+    struct OutBuf *out = sc->out;
+    int newLines = (int)countByte(rs->line, rs->lineLen, '\n');
+    if (rs->lineLen > 0 && rs->line[rs->lineLen - 1] != '\n') newLines++;
+    int newStart = sc->lineno + rs->lineDelta;
+    rs->lineDelta += newLines - 1;
+    if (outputFormat == FORMAT_JSON) return;
+
+    if (!rs->diffStarted)
+    {
+        rs->diffStarted = 1;
+        outAppendStr(out, "--- ");
+        outAppendStr(out, sc->fullpath);
+        outAppendStr(out, "\n+++ ");
+        outAppendStr(out, sc->fullpath);
+        outAppendStr(out, "\n");
+    }
+    outAppendStr(out, "@@ -");
+    outAppendInt(out, sc->lineno);
+    outAppendStr(out, " +");
+    // 替换后这一行没有了时，按 diff 的习惯写它前面一行的行号
+    outAppendInt(out, newLines == 0 ? newStart - 1 : newStart);
+    if (newLines != 1)
+    {
+        outAppendStr(out, ",");
+        outAppendInt(out, newLines);
+    }
+    outAppendStr(out, " @@\n");
+    appendDiffLines(out, '-', line, len);
+    appendDiffLines(out, '+', rs->line, rs->lineLen);
+}
+
+// 处理一个可能匹配的行
+static void replaceLine(struct replaceState *rs, const char *line, size_t len)
+{
+    rs->sc->lineno++;
+    long long n = substituteLine(rs, line, len);
+    if (n == 0)
+    {
+        keepBytes(rs, line, len);
+    }
+    else
+    {
+        rs->replaced += n;
+        if (dryRun)
+        {
+            reportDiff(rs, line, len);
+        }
+        else if (rs->tmp >= 0 || openTemp(rs) == 0)
+        {
+            appendBytes(&rs->pending, &rs->pendingLen, &rs->pendingCap, rs->line, rs->lineLen);
+            if (rs->pendingLen >= READ_BUF_SIZE) flushPending(rs);
+        }
+        else
+        {
+            rs->failed = 1;
+        }
+    }
+    rs->offset += (off_t)len;
+}
+
+/* * 改写一段完整的行
+ * 有字面量或多模式自动机时先在整段中找下一个命中，它之前的行整段保留，不逐行匹配
+ *
+ * @param ctx 改写状态
+ * @param buf 缓冲区，只包含完整的行（文件最后一行可以没有换行符）
+ * @param len 缓冲区长度
+ */
+static void replaceBlock(void *ctx, const char *buf, size_t len)
+{
+    struct replaceState *rs = ctx;
+    struct lineScanner *sc = rs->sc;
+    const char *p = buf;
+    const char *end = buf + len;
+    while (p < end && !rs->failed)
+    {
+        if (sc->ac || sc->lit)
+        {
+            const char *hit = NULL;
+            if (sc->ac)
+            {
+                int state = 0;
+                size_t pos = 0;
+                struct AcHit first;
+                if (acScan(sc->ac, p, (size_t)(end - p), &state, &pos, &first, 1) > 0) hit = p + first.start;
+            }
+            else
+            {
+                hit = literalFind(sc->lit, p, (size_t)(end - p));
+            }
+            const char *lineStart = hit ? hit : end;
+            while (lineStart > p && lineStart[-1] != '\n') lineStart--;
+            keepBytes(rs, p, (size_t)(lineStart - p));
+            sc->lineno += (int)countByte(p, (size_t)(lineStart - p), '\n');
+            rs->offset += lineStart - p;
+            p = lineStart;
+            if (hit == NULL) break;
+        }
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        const char *lineEnd = nl ? nl + 1 : end;
+        replaceLine(rs, p, (size_t)(lineEnd - p));
+        p = lineEnd;
+    }
+    if (rs->failed) sc->stop = 1;
+}
+
+/* * 改写完成：写完临时文件，保留原来的权限，fsync 后 rename 覆盖原文件
+ * 出错或被取消时删除临时文件，原文件保持不变
+ *
+ * @param rs 改写状态
+ * @param st 原文件的属性
+ */
+static void finishReplace(struct replaceState *rs, const struct stat *st)
+{
+    if (rs->tmp >= 0)
+    {
+        if (!rs->failed) flushPending(rs);
+        if (!rs->failed)
+        {
+            // 普通用户改不了所有者，此时新文件归当前用户
+            if (fchmod(rs->tmp, st->st_mode & 07777) != 0 || fsync(rs->tmp) != 0) rs->failed = 1;
+            if (fchown(rs->tmp, st->st_uid, st->st_gid) != 0) errno = 0;
+        }
+        if (close(rs->tmp) != 0) rs->failed = 1;
+        if (rs->failed || rename(rs->tmpPath, rs->target) != 0)
+        {
+            rs->failed = 1;
+            unlink(rs->tmpPath);
+        }
+    }
+    if (rs->failed)
+    {
+        printf("[warning] Fail to replace in %s, the file is left unchanged\n", rs->sc->fullpath);
+        return;
+    }
+    if (rs->replaced == 0) return;
+
+    struct OutBuf *out = rs->sc->out;
+    if (outputFormat == FORMAT_JSON)
+    {
+        outAppendStr(out, "{\"type\":\"replace\",\"path\":");
+        outAppendJson(out, rs->sc->fullpath, strlen(rs->sc->fullpath));
+        outAppendStr(out, ",\"count\":");
+        outAppendInt(out, rs->replaced);
+        outAppendStr(out, dryRun ? ",\"dry_run\":true}\n" : "}\n");
+    }
+    else if (!dryRun)
+    {
+        outAppendStr(out, "Replaced ");
+        outAppendInt(out, rs->replaced);
+        outAppendStr(out, " matches in file: ");
+        outAppendStr(out, rs->sc->fullpath);
+        outAppendStr(out, "\n");
+    }
+}
+
+/* * --replace：把文件中的所有匹配替换成 replaceText
+ * 文件按块流式读入，第一次替换时才创建临时文件，整个文件处理完后原子地 rename 覆盖原文件；
+ * 没有匹配的文件不会被改写，二进制文件按 --binary 跳过
+ *
+ * @param sc 行扫描器，fullpath 和匹配模式需要事先设置好
+ */
+static void replaceFileContent(struct lineScanner *sc)
+{
+    struct replaceState rs = {0};
+    rs.sc = sc;
+    rs.tmp = -1;
+    rs.target = sc->fullpath;
+    // -L：改写链接指向的文件，链接本身不变
+    char resolved[PATH_MAX];
+    if (followLinks && realpath(sc->fullpath, resolved) != NULL) rs.target = resolved;
+
+    struct stat st;
+    char *buf = threadReadBuf();
+    rs.src = open(rs.target, O_RDONLY);
+    if (buf == NULL || rs.src < 0 || fstat(rs.src, &st) != 0)
+    {
+        if (rs.src >= 0) close(rs.src);
+        return;
+    }
+
+    ssize_t n = readBlock(rs.src, buf, -1);
+    if (n > 0 && binaryPolicy != BINARY_TEXT && looksBinary(buf, (size_t)n)) n = 0;
+    while (n > 0 && !sc->stop && !atomic_load(&cancelled))
+    {
+        long long matchStart = statsClock();
+        feedLines(sc, buf, (size_t)n, replaceBlock, &rs);
+        statsTime(STAT_MATCH, matchStart);
+        n = readBlock(rs.src, buf, -1);
+    }
+    if (n < 0 || atomic_load(&cancelled)) rs.failed = 1;
+    if (sc->carryLen > 0 && !rs.failed) replaceBlock(&rs, sc->carry, sc->carryLen);
+    finishReplace(&rs, &st);
+
+    close(rs.src);
+    free(rs.pending);
+    free(rs.line);
+    free(rs.hits);
+    free(sc->carry);
+    free(sc->scratch);
+}
+
+/* * 按块读取整个文件并交给行扫描器匹配
+ *
+ * @param sc 行扫描器，fullpath 和匹配模式需要事先设置好
+ */
+static void scanFileContent(struct lineScanner *sc)
+{
+    if (replaceText)
+    {
+        replaceFileContent(sc);
+        return;
+    }
+    char *buf = threadReadBuf();
+    if (buf == NULL) return;
+
+    // io_uring 已经读好了第一块；文件没读完时接着从它留下的 fd 读，fd 由 ioRingRelease 关闭
+    const struct IoPrefetch *pf = sc->prefetch;
+    int fd = pf ? pf->fd : open(sc->fullpath, O_RDONLY);
+    if (fd < 0 && pf == NULL) return;
+    const char *block = pf ? pf->buf : buf;
+    ssize_t n = pf ? (ssize_t)pf->len : readBlock(fd, buf, -1);
+    if (pf) statsCount(STAT_BYTES, n);
+    // 预读用的是带偏移的读取，不会移动文件位置
+    if (pf && fd >= 0 && lseek(fd, (off_t)pf->len, SEEK_SET) < 0) n = 0;
+
+    // -z：压缩文件边读边解压，二进制判断推迟到解压出第一块之后
+    struct Decompressor *dec = NULL;
+    if (searchZip && n > 0)
+    {
+        int kind = compressionKind(block, (size_t)n);
+        if (kind != COMPRESS_NONE) dec = decompressorCreate(kind);
+    }
+
+    // 在第一块上判断是不是二进制文件，跳过时不再往下读
+    if (dec == NULL && n > 0 && binaryPolicy != BINARY_TEXT && looksBinary(block, (size_t)n))
+    {
+        if (binaryPolicy == BINARY_SKIP)
+        {
+            if (pf == NULL) close(fd);
+            return;
+        }
+        sc->binary = 1;
+    }
+    // 每读一块检查一次 --max-count 是否已经取消了搜索
+    while (n > 0 && !sc->stop && !atomic_load(&cancelled))
+    {
+        if (dec == NULL)
+        {
+            scannerFeed(sc, block, (size_t)n);
+        }
+        else if (decompressorFeed(dec, block, (size_t)n, scanDecompressed, sc) != 0)
+        {
+            // 数据损坏时已经解压出来的部分照常输出
+            break;
+        }
+        block = buf;
+        n = fd >= 0 ? readBlock(fd, buf, -1) : 0;
+    }
+    // 读到文件末尾时解压器里可能还留着最后一段输出
+    if (dec != NULL && n == 0 && !sc->stop && !atomic_load(&cancelled)) decompressorFinish(dec, scanDecompressed, sc);
+    decompressorFree(dec);
+    if (sc->carryLen > 0 && !sc->stop) scanLines(sc, sc->carry, sc->carryLen);
+    reportSummary(sc->out, sc->fullpath, sc->matched, sc->count);
+
+    if (pf == NULL) close(fd);
+    free(sc->carry);
+    free(sc->scratch);
+    free(sc->history);
+}
+
+/* * 拼接分块扫描的结果
+ * 各块的换行符个数做前缀和得到每块第一行的行号，再把块内行号换算成整个文件的行号
+ * 由最后一个完成的块调用，调用后释放任务体和分块信息
+ *
+ * @param cf 分块扫描的文件
+ */
+static void assembleChunks(struct chunkedFile *cf)
+{
+    struct taskBody *task = cf->task;
+    struct OutBuf *out = outLocal();
+    if (cf->nameMatched) reportFile(out, task->path, cf->namePattern);
+
+    long long linesBefore = 0;
+    long long count = 0;
+    for (int i = 0; i < cf->numChunks; i++)
+    {
+        struct fileChunk *chunk = &cf->chunks[i];
+        long long base = linesBefore + chunk->skipFirst;
+        size_t prev = 0;
+        for (size_t f = 0; f < chunk->numFixups; f++)
+        {
+            outAppend(out, chunk->out.data + prev, chunk->fixups[f].offset - prev);
+            outAppendInt(out, base + chunk->fixups[f].lineno);
+            prev = chunk->fixups[f].offset;
+        }
+        outAppend(out, chunk->out.data + prev, chunk->out.len - prev);
+        linesBefore += (long long)chunk->newlines;
+        count += chunk->count;
+        free(chunk->out.data);
+        free(chunk->fixups);
+    }
+    if (outputMode == OUTPUT_COUNT) reportSummary(out, task->path, 0, count);
+
+    finishFile(out, task);
+    pthread_mutex_destroy(&cf->mutex);
+    free(cf->chunks);
+    free(cf);
+    free(task->path);
+    free(task->name);
+    free(task);
+}
+
+/* * 扫描大文件中的一块
+ * 从 start - 1 开始读：如果那个字节不是换行符，说明第一行属于前一块，跳到下一个换行符之后再开始匹配；
+ * 读到 end 时如果最后一行还没结束，继续读到行尾。同时统计 [start, end) 中的换行符个数
+ *
+ * @param arg 块任务指针
+ */
+static void scanChunk(void *arg)
+{
+    struct chunkTask *ct = arg;
+    struct chunkedFile *cf = ct->file;
+    struct fileChunk *chunk = &cf->chunks[ct->index];
+    free(ct);
+
+    struct lineScanner sc = cf->proto;
+    sc.out = &chunk->out;
+    sc.deferLineno = 1;
+
+    int fd = open(cf->task->path, O_RDONLY);
+    char *buf = threadReadBuf();
+    if (fd >= 0 && buf != NULL)
+    {
+        off_t pos = chunk->start > 0 ? chunk->start - 1 : 0;
+        int owning = chunk->start == 0; // 已经到了本块的第一行
+        int done = 0;                   // 最后一行已经读完，只剩换行符计数
+        ssize_t n;
+        while ((pos < chunk->end || (owning && !done)) && (n = readBlock(fd, buf, pos)) > 0)
+        {
+            off_t blockEnd = pos + n;
+            off_t countFrom = pos > chunk->start ? pos : chunk->start;
+            off_t countTo = blockEnd < chunk->end ? blockEnd : chunk->end;
+            if (countTo > countFrom)
+            {
+                chunk->newlines += countByte(buf + (countFrom - pos), (size_t)(countTo - countFrom), '\n');
+            }
+
+            const char *data = buf;
+            size_t len = (size_t)n;
+            if (!owning)
+            {
+                const char *nl = memchr(data, '\n', len);
+                if (nl == NULL)
+                {
+                    pos = blockEnd;
+                    continue;
+                }
+                off_t lineStart = pos + (nl - buf) + 1;
+                chunk->skipFirst = lineStart > chunk->start;
+                owning = 1;
+                done = lineStart >= chunk->end;
+                len -= (size_t)(nl + 1 - data);
+                data = nl + 1;
+            }
+
+            off_t dataPos = blockEnd - (off_t)len;
+            if (!done && dataPos >= chunk->end && sc.carryLen == 0)
+            {
+                // 上一块数据正好在 end 处结束了一行
+                done = 1;
+            }
+            if (!done && (sc.stop || atomic_load(&cancelled)))
+            {
+                // --max-count 已经取消了搜索，后面的块已经输出的行号还要靠这一块的换行符个数
+                done = 1;
+            }
+            if (!done)
+            {
+                if (blockEnd > chunk->end)
+                {
+                    // 越过 end 的部分只读到最后一行的行尾
+                    size_t inside = dataPos < chunk->end ? (size_t)(chunk->end - dataPos) : 0;
+                    size_t take = len;
+                    if (inside > 0 && data[inside - 1] == '\n')
+                    {
+                        take = inside;
+                    }
+                    else
+                    {
+                        const char *nl = memchr(data + inside, '\n', len - inside);
+                        if (nl) take = (size_t)(nl - data) + 1;
+                    }
+                    done = take < len || (take > 0 && data[take - 1] == '\n');
+                    len = take;
+                }
+                scannerFeed(&sc, data, len);
+            }
+            pos = blockEnd;
+        }
+        if (owning && sc.carryLen > 0 && !sc.stop) scanLines(&sc, sc.carry, sc.carryLen);
+    }
+    chunk->count = sc.count;
+    if (fd >= 0) close(fd);
+    free(sc.carry);
+    free(sc.scratch);
+    chunk->fixups = sc.fixups;
+    chunk->numFixups = sc.numFixups;
+
+    pthread_mutex_lock(&cf->mutex);
+    int last = --cf->remaining == 0;
+    pthread_mutex_unlock(&cf->mutex);
+    if (last) assembleChunks(cf);
+}
+
+/* * 把大文件切成 CHUNK_SIZE 大小的块，加入线程池并行扫描
+ * 队列已满时当前线程直接扫描那一块；第一块总是由当前线程最后扫描，保证返回前不会被释放
+ *
+ * @param task 任务体，成功时由最后完成的块释放
+ * @param proto 匹配设置
+ * @param size 文件大小
+ * @param nameMatched 文件名是否匹配
+ * @param namePattern 文件名命中的模式，没有时为 NULL
+ * @return 0 已经分块，-1 二进制文件或内存不足，调用者应当按普通文件扫描
+ */
+static int scanInChunks(struct taskBody *task, const struct lineScanner *proto, off_t size,
+                        int nameMatched, const char *namePattern)
+{
+    // -l 在第一个匹配处就停止，顺序读更合适
+    if (outputMode == OUTPUT_FILES) return -1;
+    // 上下文可能跨过块的边界，改写文件只能从头到尾顺序进行，都由一个线程扫描
+    if (contextBefore > 0 || contextAfter > 0 || replaceText) return -1;
+    // 二进制文件不分块，由 scanFileContent 按 --binary 处理；压缩文件只能从头顺序解压，也不分块
+    if (binaryPolicy != BINARY_TEXT || searchZip)
+    {
+        char head[BINARY_SNIFF_SIZE];
+        int fd = open(task->path, O_RDONLY);
+        ssize_t n = fd >= 0 ? pread(fd, head, sizeof(head), 0) : -1;
+        if (fd >= 0) close(fd);
+        if (n > 0 && binaryPolicy != BINARY_TEXT && looksBinary(head, (size_t)n)) return -1;
+        if (n > 0 && searchZip && compressionKind(head, (size_t)n) != COMPRESS_NONE) return -1;
+    }
+
+    int numChunks = (int)((size + CHUNK_SIZE - 1) / CHUNK_SIZE);
+    struct chunkedFile *cf = calloc(1, sizeof(struct chunkedFile));
+    struct chunkTask **tasks = calloc((size_t)numChunks, sizeof(struct chunkTask*));
+    if (cf == NULL || tasks == NULL || (cf->chunks = calloc((size_t)numChunks, sizeof(struct fileChunk))) == NULL)
+    {
+        if (cf) free(cf->chunks);
+        free(cf);
+        free(tasks);
+        return -1;
+    }
+
+    cf->task = task;
+    cf->proto = *proto;
+    cf->nameMatched = nameMatched;
+    cf->namePattern = namePattern;
+    cf->numChunks = numChunks;
+    cf->remaining = numChunks;
+    pthread_mutex_init(&cf->mutex, NULL);
+    for (int i = 0; i < numChunks; i++)
+    {
+        cf->chunks[i].start = (off_t)i * CHUNK_SIZE;
+        cf->chunks[i].end = i == numChunks - 1 ? size : (off_t)(i + 1) * CHUNK_SIZE;
+        tasks[i] = malloc(sizeof(struct chunkTask));
+        tasks[i]->file = cf;
+        tasks[i]->index = i;
+    }
+
+    for (int i = 1; i < numChunks; i++)
+    {
+        if (ThreadPoolTryAdd(task->pool, scanChunk, tasks[i]) != 0) scanChunk(tasks[i]);
+    }
+    scanChunk(tasks[0]);
+    free(tasks);
+    return 0;
+}
+
+/* * 多模式匹配函数
+ * 文件名包含模式文件中任意一个字符串即算匹配，输出时注明命中的模式
+ * 开启内容匹配时，用同一个自动机一遍扫完整个文件
+ *
+ * @param arg 任务体指针，包含路径和输出文件指针
+ */
+void findWithPatternSet(void *arg)
+{
+    struct taskBody *task = (struct taskBody*)arg;
+    char *fullpath = task->path;
+    char *name = task->name;
+    struct OutBuf *out = outLocal();
+
+    struct stat st;
+    if (!atomic_load(&cancelled) && statFile(fullpath, &st) == 0 && S_ISREG(st.st_mode))
+    {
+        statsCount(STAT_FILES, 1);
+        int state = 0;
+        size_t pos = 0;
+        struct AcHit hit;
+        int nameMatched = acScan(patternSet, name, strlen(name), &state, &pos, &hit, 1) > 0;
+        const char *hitPattern = nameMatched ? patternSet->patterns[hit.pattern] : NULL;
+        // -l 时文件名已经匹配就不必再读内容
+        if (matchContent && !task->skipContent && !(nameMatched && outputMode == OUTPUT_FILES) &&
+            firstContentVisit(&st))
+        {
+            struct lineScanner sc = {0};
+            sc.fullpath = fullpath;
+            sc.out = out;
+            sc.ac = patternSet;
+            // 大文件交给多个线程分块扫描，任务体由最后完成的块释放
+            if (st.st_size > CHUNK_THRESHOLD)
+            {
+                releasePrefetch(task);
+                if (scanInChunks(task, &sc, st.st_size, nameMatched, hitPattern) == 0) return;
+            }
+            sc.prefetch = task->prefetch;
+
+            if (nameMatched) reportFile(out, fullpath, hitPattern);
+            scanFileContent(&sc);
+        }
+        else if (nameMatched)
+        {
+            reportFile(out, fullpath, hitPattern);
+        }
+    }
+
+    releasePrefetch(task);
+    finishFile(out, task);
+    free(task->path);
+    free(task->name);
+    free(task);
+    return;
+}
+
+/* * 建索引任务
+ * 记录 inode、大小和修改时间；文件相对旧索引有变化（或者没有旧索引）时，读取整个文件，
+ * 提取去重后的三字节组交给索引构建器
+ *
+ * @param arg 任务体指针，包含路径和文件编号
+ */
+void indexFileTask(void *arg)
+{
+    struct taskBody *task = (struct taskBody*)arg;
+
+    struct stat st;
+    int fd = -1;
+    char *buf = threadReadBuf();
+    if (buf != NULL && stat(task->path, &st) == 0 && S_ISREG(st.st_mode))
+    {
+        indexBuilderSetFileInfo(indexBuilder, task->fileId, (uint64_t)st.st_ino, (uint64_t)st.st_size, statMtimeNs(&st));
+    }
+    else
+    {
+        st.st_mode = 0;
+    }
+
+    // 文件没有变化时沿用旧索引，不需要读取
+    if (S_ISREG(st.st_mode) && !indexBuilderReuseFile(indexBuilder, task->fileId) &&
+        (fd = open(task->path, O_RDONLY)) >= 0)
+    {
+        uint32_t *trigrams = NULL;
+        size_t count = 0;
+        size_t cap = 0;
+        size_t uniqueCount = 0;
+        struct TrigramWindow w = {0, 0};
+        ssize_t n;
+        while ((n = read(fd, buf, READ_BUF_SIZE)) > 0)
+        {
+            collectTrigrams(&w, buf, (size_t)n, &trigrams, &count, &cap);
+            // 大文件边读边去重，数组不会随文件大小无限增长
+            if (count > uniqueCount * 2 + (1 << 20))
+            {
+                count = uniqueTrigrams(trigrams, count);
+                uniqueCount = count;
+            }
+        }
+        count = uniqueTrigrams(trigrams, count);
+        indexBuilderAddTrigrams(indexBuilder, task->fileId, trigrams, count);
+        free(trigrams);
+        close(fd);
+    }
+
+    free(task->path);
+    free(task->name);
+    free(task);
+}
+
+/* * 文件是不是 -z 能解压的压缩文件，只读开头几个字节
+ *
+ * @param path 文件路径
+ * @return 1 是，0 不是或者打不开
+ */
+static int isCompressedFile(const char *path)
+{
+    char head[4];
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+    ssize_t n = pread(fd, head, sizeof(head), 0);
+    close(fd);
+    return n > 0 && compressionKind(head, (size_t)n) != COMPRESS_NONE;
+}
+
+/* * 按索引调度搜索任务
+ * 不遍历目录，直接使用索引中记录的文件；内容匹配时先用模式中必须出现的字符串查询候选文件，
+ * 只有候选文件才读取内容，其余文件只匹配文件名
+ *
+ * @param reader 索引读取器
+ * @param literal 内容匹配时必须出现的字符串，没有时为 NULL
+ * @param namePattern 文件名模式字符串
+ * @param reg 正则表达式
+ * @param pool 线程池指针
+ */
+void scheduleFromIndex(struct IndexReader *reader, const char *literal, char *namePattern, regex_t *reg,
+                       struct ThreadPool *pool)
+{
+    uint64_t numFiles = indexNumFiles(reader);
+    unsigned char *candidates = calloc(numFiles ? numFiles : 1, 1);
+
+    int filtered = 0;
+    if (matchContent && patternSet)
+    {
+        // 多模式时取所有模式候选文件的并集，任何一个模式太短都无法过滤
+        filtered = 1;
+        for (int i = 0; i < patternSet->numPatterns && filtered; i++)
+        {
+            filtered = indexQuery(reader, patternSet->patterns[i], patternSet->patternLens[i], candidates);
+        }
+    }
+    else if (matchContent && literal)
+    {
+        filtered = indexQuery(reader, literal, strlen(literal), candidates);
+    }
+    if (!filtered) memset(candidates, 1, numFiles);
+
+    for (uint64_t id = 0; id < numFiles && !atomic_load(&cancelled); id++)
+    {
+        const char *fullpath = indexFilePath(reader, id);
+        const char *slash = strrchr(fullpath, '/');
+        const char *name = slash ? slash + 1 : fullpath;
+        // 索引记录的是文件原始字节的三字节组，-z 时压缩文件解压后的内容不在其中，不能用索引排除
+        int skip = !candidates[id] && !(searchZip && isCompressedFile(fullpath));
+        if (scheduleFile(fullpath, name, namePattern, reg, pool, skip) != 0) break;
+    }
+    free(candidates);
+}
+
+#ifdef __linux__
+// 路径在根目录下第几层，根目录的直接子项为第 1 层
+static int pathDepth(const char *root, const char *fullpath)
+{
+    int depth = 0;
+    for (const char *p = fullpath + strlen(root); *p != '\0'; p++)
+    {
+        if (*p == '/') depth++;
+    }
+    return depth;
+}
+
+// 监视的目录：路径和在这个目录中生效的 .gitignore 规则
+struct watchDir
+{
+    char *path;
+    const struct IgnoreList *rules; // 可以为 NULL
+};
+
+// 监视模式下 inotify 的 wd 到目录的映射
+static struct watchDir *watchDirs = NULL;
+static int watchDirsCap = 0;
+// 监视期间读到的所有 .gitignore，子目录的规则链指向上层目录的列表，所以目录不再被监视后也不能释放，退出时一起释放
+static struct IgnoreList **watchIgnores = NULL;
+static int numWatchIgnores = 0;
+
+/* * 一个目录项是否被 .gitignore 忽略，或者是 .git 目录；--no-ignore 时总是返回 0
+ *
+ * @param rules 所在目录生效的规则，可以为 NULL
+ * @param fullpath 完整路径
+ * @param name 文件名
+ * @param isDir 是否是目录
+ * @return 1 忽略，0 不忽略
+ */
+static int watchIgnored(const struct IgnoreList *rules, const char *fullpath, const char *name, int isDir)
+{
+    if (!useIgnore) return 0;
+    if (isDir && strcmp(name, ".git") == 0) return 1;
+    return ignoreMatch(rules, fullpath, name, isDir);
+}
+
+/* * 监视一个目录及其所有没有被忽略的子目录
+ *
+ * @param fd inotify 文件描述符
+ * @param dir 目录路径
+ * @param parentRules 上层目录生效的 .gitignore 规则，可以为 NULL
+ */
+static void addWatchRecursive(int fd, const char *dir, const struct IgnoreList *parentRules)
+{
+    int wd = inotify_add_watch(fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ONLYDIR);
+    if (wd < 0)
+    {
+        if (errno == ENOSPC)
+        {
+            printf("[warning] Too many watches, %s is not watched (see /proc/sys/fs/inotify/max_user_watches)\n", dir);
+        }
+        return;
+    }
+    if (wd >= watchDirsCap)
+    {
+        int newCap = watchDirsCap ? watchDirsCap : 256;
+        while (newCap <= wd) newCap *= 2;
+        watchDirs = realloc(watchDirs, sizeof(struct watchDir) * newCap);
+        memset(watchDirs + watchDirsCap, 0, sizeof(struct watchDir) * (newCap - watchDirsCap));
+        watchDirsCap = newCap;
+    }
+
+    const struct IgnoreList *rules = parentRules;
+    struct IgnoreList *ignore = useIgnore ? ignoreLoad(dir, parentRules) : NULL;
+    if (ignore != NULL)
+    {
+        watchIgnores = realloc(watchIgnores, sizeof(struct IgnoreList*) * (numWatchIgnores + 1));
+        watchIgnores[numWatchIgnores++] = ignore;
+        rules = ignore;
+    }
+    free(watchDirs[wd].path);
+    watchDirs[wd].path = strdup(dir);
+    watchDirs[wd].rules = rules;
+
+    struct DirStream *ds = dirStreamOpen(AT_FDCWD, dir);
+    if (ds == NULL) return;
+    struct DirEntry entry;
+    while (dirStreamRead(ds, &entry) > 0)
+    {
+        if (entry.type != DT_DIR || strcmp(entry.name, ".") == 0 || strcmp(entry.name, "..") == 0) continue;
+        char sub[1024];
+        snprintf(sub, sizeof(sub), "%s/%s", dir, entry.name);
+        if (watchIgnored(rules, sub, entry.name, 1)) continue;
+        addWatchRecursive(fd, sub, rules);
+    }
+    dirStreamClose(ds);
+}
+
+/* * 监视目录树，对新建、写入完成或移入的文件重新搜索，结果每处理完一批事件就立即输出
+ * 新建的目录会被加入监视并整体搜索一遍；事件队列溢出时整棵树重新搜索一遍
+ * 这个函数只在 read 出错时返回
+ *
+ * @param path 根目录
+ * @param namePattern 文件名模式字符串
+ * @param reg 正则表达式
+ * @param pool 线程池指针
+ * @return 非0 表示无法监视
+ */
+int watchAndSearch(const char *path, char *namePattern, regex_t *reg, struct ThreadPool *pool)
+{
+    int fd = inotify_init1(IN_CLOEXEC);
+    if (fd < 0)
+    {
+        printf("Fail to initialize inotify\n");
+        return 1;
+    }
+    addWatchRecursive(fd, path, NULL);
+    printf("[Watch] Watching %s for changes\n", path);
+    fflush(stdout);
+
+    // 同一批事件中同一个文件可能被写入多次，只搜索一次
+    char **batch = NULL;
+    int batchLen = 0;
+    int batchCap = 0;
+    char buf[64 * 1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+    while (1)
+    {
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        // -L 的去重只在一批事件之内有效，被修改的文件要能再次搜索
+        if (visited) visitedClear(visited);
+
+        for (char *p = buf; p < buf + n; )
+        {
+            const struct inotify_event *ev = (const struct inotify_event*)p;
+            p += sizeof(struct inotify_event) + ev->len;
+
+            if (ev->mask & IN_Q_OVERFLOW)
+            {
+                printf("[warning] inotify queue overflowed, searching %s again\n", path);
+                traverseAndScheduleSearch(path, namePattern, reg, pool);
+                continue;
+            }
+            if (ev->wd < 0 || ev->wd >= watchDirsCap || watchDirs[ev->wd].path == NULL) continue;
+            if (ev->mask & IN_IGNORED)
+            {
+                free(watchDirs[ev->wd].path);
+                watchDirs[ev->wd].path = NULL;
+                continue;
+            }
+            if (ev->len == 0) continue;
+
+            // 和遍历时一样，被 .gitignore 忽略的文件和目录（以及 .git）不搜索，也不加入监视
+            const struct IgnoreList *rules = watchDirs[ev->wd].rules;
+            char fullpath[1024];
+            snprintf(fullpath, sizeof(fullpath), "%s/%s", watchDirs[ev->wd].path, ev->name);
+            if (watchIgnored(rules, fullpath, ev->name, (ev->mask & IN_ISDIR) != 0)) continue;
+            if (ev->mask & IN_ISDIR)
+            {
+                // 目录在加入监视之前就可能已经有文件写入了，所以整体搜索一遍
+                // 它在根目录下的深度决定还能深入几层；--type d 时目录本身也要匹配一次
+                if (ev->mask & (IN_CREATE | IN_MOVED_TO))
+                {
+                    int depth = rootDepth() - pathDepth(path, fullpath);
+                    addWatchRecursive(fd, fullpath, rules);
+                    if (typeFilter == 'd' && depth >= -1 && statMatches(AT_FDCWD, fullpath))
+                    {
+                        scheduleFile(fullpath, ev->name, namePattern, reg, pool, 1);
+                    }
+                    traverseDir(AT_FDCWD, fullpath, fullpath, namePattern, reg, pool, rules, depth);
+                }
+                continue;
+            }
+            // 新建的文件等写入完成（IN_CLOSE_WRITE）后再搜索
+            if ((ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) == 0) continue;
+            // 和遍历时一样的过滤条件
+            if (typeFilter == 'd' || !extMatches(ev->name) || rootDepth() - pathDepth(path, fullpath) < -1 ||
+                !statMatches(AT_FDCWD, fullpath)) continue;
+
+            int seen = 0;
+            for (int i = 0; i < batchLen && !seen; i++)
+            {
+                seen = strcmp(batch[i], fullpath) == 0;
+            }
+            if (seen) continue;
+            if (batchLen == batchCap)
+            {
+                batchCap = batchCap ? batchCap * 2 : 64;
+                batch = realloc(batch, sizeof(char*) * batchCap);
+            }
+            batch[batchLen++] = strdup(fullpath);
+            scheduleFile(fullpath, ev->name, namePattern, reg, pool, 0);
+        }
+
+        waitForSearch(pool);
+        outFlushAll();
+        for (int i = 0; i < batchLen; i++) free(batch[i]);
+        batchLen = 0;
+    }
+
+    free(batch);
+    for (int i = 0; i < watchDirsCap; i++) free(watchDirs[i].path);
+    free(watchDirs);
+    watchDirs = NULL;
+    watchDirsCap = 0;
+    for (int i = 0; i < numWatchIgnores; i++) ignoreFree(watchIgnores[i]);
+    free(watchIgnores);
+    watchIgnores = NULL;
+    numWatchIgnores = 0;
+    close(fd);
+    return 0;
+}
+#else
+int watchAndSearch(const char *path, char *namePattern, regex_t *reg, struct ThreadPool *pool)
+{
+    printf("--watch is only supported on Linux\n");
+    return 1;
+}
+#endif
+
+/* * 模式匹配函数
+ * 该函数使用递归方式实现通配符模式匹配
+ * 支持 '*' 和 '?' 两种通配符
+ *
+ * @param filename 文件名
+ * @param pattern 模式字符串
+ * @return 1 如果匹配成功，0 如果匹配失败
+ */
+int matchPattern(const char *filename, const char *pattern)
+{
+    if (*pattern == '\0')
+    {
+        return *filename == '\0';
+    }
+
+    if (*pattern == '*')
+    {
+        while (*(pattern + 1) == '*')
+        {
+            pattern += 1; // 跳过连续的星号
+        }
+
+        if (*(pattern + 1) == '\0')
+        {
+            return 1; // 如果模式是以星号结尾，匹配成功
+        }
+
+        for (; *filename != '\0'; filename++)
+        {
+            if (matchPattern(filename, pattern + 1))
+            {
+                return 1; // 如果后续匹配成功，返回成功
+            }
+        }
+
+        // 如果上面的循环没有找到匹配，那么filename此时已经是空字符串了，再匹配一下空字符看看
+        return matchPattern(filename, pattern + 1);
+    }
+
+    // 如果两个字符相同，或者模式字符是问号（问号匹配一个任意字符），向下匹配
+    if (*pattern == '?' || *pattern == *filename)
+    {
+        if (*filename == '\0')
+        {
+            return 0;
+        }
+        return matchPattern(filename + 1, pattern + 1);
+    }
+
+    return 0;
+}
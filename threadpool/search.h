@@ -0,0 +1,91 @@
+//
+// Created by 吨吨 on 2026/10/19.
+//
+
+#ifndef SEARCH_H
+#define SEARCH_H
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "threadpool.h"
+#include "literal.h"
+#include "acmatch.h"
+#include "reorder.h"
+#include "trigram.h"
+#include "uring.h"
+#include "visited.h"
+#include "platform.h"
+
+// 搜索引擎：遍历目录、把文件交给线程池、匹配文件名和内容、输出结果
+// 命令行（pfind.c）只负责解析参数，设置下面这些全局变量，再调用遍历和等待的函数；
+// 操作系统相关的部分在 platform.c 中
+
+// 二进制文件的处理方式：跳过、只报告是否匹配、当作文本搜索
+#define BINARY_SKIP 0
+#define BINARY_REPORT 1
+#define BINARY_TEXT 2
+
+// 内容匹配结果的输出方式
+#define OUTPUT_LINES 0 // 输出每一个匹配的行
+#define OUTPUT_FILES 1 // -l：只输出有匹配的文件路径，遇到第一个匹配就不再读这个文件
+#define OUTPUT_COUNT 2 // --count：每个文件只输出匹配的行数
+// 结果的格式
+#define FORMAT_TEXT 0 // 给人看的文本
+#define FORMAT_JSON 1 // --json：每条结果一行 JSON（NDJSON）
+#define FORMAT_NULL 2 // --null：只输出路径，以 '\0' 结尾，可以直接交给 xargs -0
+
+// --locality：每个目录内的文件按磁盘上的位置排序后再交给线程池，并提前发出预读提示
+#define LOCALITY_NONE 0
+#define LOCALITY_INODE 1  // 按 inode 号，inode 相近的文件数据通常也相近
+#define LOCALITY_EXTENT 2 // 按 FIEMAP 得到的第一个区段的物理偏移，取不到时退回 inode
+
+// io_uring 同时在读的文件数，以及每个文件预读的字节数，大部分源文件一次就能读完
+#define IO_DEPTH 64
+#define PREFETCH_SIZE (64 * 1024)
+
+extern int matchContent;
+extern struct LiteralMatcher *contentLiteral;
+extern int literalPrefilter;
+extern struct AhoCorasick *patternSet;
+extern int ignoreCase;
+extern int foldText;
+extern struct ReorderBuffer *reorder;
+extern int sortByPath;
+extern struct IndexBuilder *indexBuilder;
+extern int binaryPolicy;
+extern int searchZip;
+extern int useIgnore;
+extern int maxDepth;
+extern long long minSize;
+extern long long maxSize;
+extern int64_t newerThanNs;
+extern char **extList;
+extern int numExts;
+extern int typeFilter;
+extern int outputMode;
+extern int outputFormat;
+extern int contextBefore;
+extern int contextAfter;
+extern int allMatches;
+extern const char *replaceText;
+extern size_t replaceLen;
+extern int replaceRefs;
+extern int dryRun;
+extern long long maxCount;
+extern atomic_llong resultBudget;
+extern atomic_int cancelled;
+extern struct IoRing *ioRing;
+extern int localityOrder;
+extern int followLinks;
+extern struct VisitedSet *visited;
+
+void traverseAndScheduleSearch(const char *path, char *namePattern, regex_t *reg, struct ThreadPool *pool);
+void scheduleFromIndex(struct IndexReader *reader, const char *literal, char *namePattern, regex_t *reg,
+                       struct ThreadPool *pool);
+int watchAndSearch(const char *path, char *namePattern, regex_t *reg, struct ThreadPool *pool);
+void waitForSearch(struct ThreadPool *pool);
+void prefetchReady(void *arg, struct IoPrefetch *pf);
+void reportStats(struct ThreadPool *pool, int queueCap, long long wallNs);
+int matchPattern(const char *filename, const char *pattern);
+
+#endif //SEARCH_H
@@ -0,0 +1,110 @@
+//
+// Created by 吨吨 on 2026/10/19.
+//
+#include "stats.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static int enabled = 0;
+static struct Stats *allStats = NULL;
+// 只保护 allStats 链表，每个线程第一次计数时加一次锁
+static pthread_mutex_t statsMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t statsKey;
+static pthread_once_t statsOnce = PTHREAD_ONCE_INIT;
+
+static void createStatsKey(void)
+{
+    pthread_key_create(&statsKey, NULL);
+}
+
+// 开始统计，要在创建线程池之前调用
+void statsEnable(void)
+{
+    enabled = 1;
+}
+
+// 当前线程的计数器，第一次调用时创建
+static struct Stats *statsLocal(void)
+{
+    pthread_once(&statsOnce, createStatsKey);
+    struct Stats *st = pthread_getspecific(statsKey);
+    if (st != NULL) return st;
+
+    // sizeof(struct Stats) 已经是 STATS_ALIGN 的整数倍，满足 aligned_alloc 的要求
+    st = aligned_alloc(STATS_ALIGN, sizeof(struct Stats));
+    if (st == NULL) return NULL;
+    memset(st, 0, sizeof(struct Stats));
+    pthread_mutex_lock(&statsMutex);
+    st->nextStats = allStats;
+    allStats = st;
+    pthread_mutex_unlock(&statsMutex);
+
+    pthread_setspecific(statsKey, st);
+    return st;
+}
+
+/* * 读单调时钟
+ *
+ * @return 纳秒，没有开启统计时返回 0
+ */
+long long statsClock(void)
+{
+    if (!enabled) return 0;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* * 把从 since 到现在的时间记到当前线程的某个阶段上
+ *
+ * @param phase STAT_TRAVERSE 等
+ * @param since statsClock 的返回值
+ */
+void statsTime(int phase, long long since)
+{
+    if (!enabled) return;
+    struct Stats *st = statsLocal();
+    if (st != NULL) st->ns[phase] += statsClock() - since;
+}
+
+// 当前线程的某个计数器加 n
+void statsCount(int counter, long long n)
+{
+    if (!enabled) return;
+    struct Stats *st = statsLocal();
+    if (st != NULL) st->count[counter] += n;
+}
+
+/* * 合计所有线程的计数器
+ * 会读取其他线程的计数器，只能在没有任务运行时调用
+ *
+ * @param total 合计结果
+ */
+void statsSum(struct Stats *total)
+{
+    memset(total, 0, sizeof(struct Stats));
+    pthread_mutex_lock(&statsMutex);
+    for (struct Stats *st = allStats; st != NULL; st = st->nextStats)
+    {
+        for (int i = 0; i < STAT_PHASES; i++) total->ns[i] += st->ns[i];
+        for (int i = 0; i < STAT_COUNTERS; i++) total->count[i] += st->count[i];
+    }
+    pthread_mutex_unlock(&statsMutex);
+}
+
+// 释放所有线程的计数器，线程池销毁之后调用
+void statsFreeAll(void)
+{
+    pthread_mutex_lock(&statsMutex);
+    struct Stats *st = allStats;
+    allStats = NULL;
+    pthread_mutex_unlock(&statsMutex);
+    while (st != NULL)
+    {
+        struct Stats *next = st->nextStats;
+        free(st);
+        st = next;
+    }
+}
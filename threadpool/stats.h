@@ -0,0 +1,40 @@
+//
+// Created by 吨吨 on 2026/10/19.
+//
+
+#ifndef STATS_H
+#define STATS_H
+
+// --stats：各阶段耗时和计数
+// 每个线程只累加自己的计数器，不需要加锁；计数器按缓存行对齐，大小也是缓存行的整数倍，不同线程的计数器不会落在同一个缓存行上；结束时 statsSum 把所有线程的计数器加在一起
+// 没有调用 statsEnable 时所有函数都直接返回，不读时钟
+#define STAT_TRAVERSE 0 // 读目录
+#define STAT_STAT 1     // stat / statx
+#define STAT_READ 2     // 读文件内容
+#define STAT_MATCH 3    // 匹配（包括把结果追加到输出缓冲区）
+#define STAT_OUTPUT 4   // 把结果写出
+#define STAT_PHASES 5
+
+#define STAT_DIRS 0
+#define STAT_FILES 1
+#define STAT_BYTES 2
+#define STAT_RESULTS 3
+#define STAT_COUNTERS 4
+
+#define STATS_ALIGN 64 // 缓存行大小
+
+struct Stats
+{
+    _Alignas(STATS_ALIGN) long long ns[STAT_PHASES]; // 各阶段的耗时（纳秒）
+    long long count[STAT_COUNTERS];
+    struct Stats *nextStats; // 所有线程的计数器串成链表，线程退出后仍然保留
+};
+
+void statsEnable(void);
+long long statsClock(void);
+void statsTime(int phase, long long since);
+void statsCount(int counter, long long n);
+void statsSum(struct Stats *total);
+void statsFreeAll(void);
+
+#endif //STATS_H
@@ -0,0 +1,33 @@
+//
+// Created by 吨吨 on 2026/10/19.
+//
+
+#ifndef CHECK_H
+#define CHECK_H
+#include <stdio.h>
+
+// 单元测试用的断言：失败时打印位置和表达式后继续往下检查，main 最后用 checkResult 的返回值退出
+static int checkFailed = 0;
+
+#define CHECK(cond)                                                              \
+    do                                                                           \
+    {                                                                            \
+        if (!(cond))                                                             \
+        {                                                                        \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            checkFailed++;                                                       \
+        }                                                                        \
+    } while (0)
+
+static int checkResult(const char *name)
+{
+    if (checkFailed > 0)
+    {
+        fprintf(stderr, "%s: %d check(s) failed\n", name, checkFailed);
+        return 1;
+    }
+    printf("%s: ok\n", name);
+    return 0;
+}
+
+#endif //CHECK_H
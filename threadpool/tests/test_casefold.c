@@ -0,0 +1,144 @@
+//
+// Created by 吨吨 on 2026/10/19.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "casefold.h"
+#include "check.h"
+#include "literal.h"
+
+static void testFoldCodepoint(void)
+{
+    CHECK(foldCodepoint('A') == 'a');
+    CHECK(foldCodepoint('z') == 'z');
+    CHECK(foldCodepoint('@') == '@');
+    CHECK(foldCodepoint(0xC4) == 0xE4);   // Ä -> ä
+    CHECK(foldCodepoint(0xD7) == 0xD7);   // × 不是字母
+    CHECK(foldCodepoint(0x178) == 0xFF);  // Ÿ -> ÿ
+    CHECK(foldCodepoint(0x139) == 0x13A); // Ĺ -> ĺ，这一段奇数为大写
+    CHECK(foldCodepoint(0x130) == 0x130); // İ 的小写长度不同，不折叠
+    CHECK(foldCodepoint(0x3A3) == 0x3C3); // Σ -> σ
+    CHECK(foldCodepoint(0x3C2) == 0x3C3); // ς -> σ
+    CHECK(foldCodepoint(0x386) == 0x3AC); // Ά -> ά
+    CHECK(foldCodepoint(0x416) == 0x436); // Ж -> ж
+    CHECK(foldCodepoint(0x401) == 0x451); // Ё -> ё
+    CHECK(foldCodepoint(0x531) == 0x561); // Ա -> ա
+    CHECK(foldCodepoint(0xFF21) == 0xFF41); // Ａ -> ａ
+    CHECK(foldCodepoint(0x4E2D) == 0x4E2D); // 中
+}
+
+// 每个字符的所有大小写形式都能列出来，并且折叠结果相同
+static void testCaseVariants(void)
+{
+    uint32_t out[CASE_MAX_VARIANTS];
+    int n = caseVariants(0x3C3, out);
+    CHECK(n == 3);
+    int seen = 0;
+    for (int i = 0; i < n; i++)
+    {
+        if (out[i] == 0x3A3) seen |= 1;
+        if (out[i] == 0x3C2) seen |= 2;
+        if (out[i] == 0x3C3) seen |= 4;
+    }
+    CHECK(seen == 7);
+
+    CHECK(caseVariants('q', out) == 2 && out[0] == 'q' && out[1] == 'Q');
+    CHECK(caseVariants(0xFF, out) == 2 && out[1] == 0x178);
+    CHECK(caseVariants('1', out) == 1 && out[0] == '1');
+
+    for (uint32_t cp = 0; cp < 0x10000; cp++)
+    {
+        n = caseVariants(cp, out);
+        int ok = n >= 1 && n <= CASE_MAX_VARIANTS;
+        for (int i = 0; i < n; i++) ok = ok && foldCodepoint(out[i]) == foldCodepoint(cp);
+        if (!ok)
+        {
+            fprintf(stderr, "caseVariants(U+%04X)\n", (unsigned)cp);
+            CHECK(ok);
+            break;
+        }
+    }
+}
+
+static void testUtf8(void)
+{
+    unsigned char buf[4];
+    uint32_t cps[] = {'a', 0xE4, 0x3C3, 0x4E2D, 0x1F600};
+    size_t lens[] = {1, 2, 2, 3, 4};
+    for (int i = 0; i < 5; i++)
+    {
+        uint32_t cp;
+        CHECK(utf8Encode(cps[i], buf) == lens[i]);
+        CHECK(utf8Decode(buf, lens[i], &cp) == lens[i] && cp == cps[i]);
+    }
+
+    // 不合法的字节按单个字节处理：孤立的后续字节、被截断的序列、过长编码
+    uint32_t cp;
+    CHECK(utf8Decode((const unsigned char*)"\x80" "a", 2, &cp) == 1 && cp >= 0x110000);
+    CHECK(utf8Decode((const unsigned char*)"\xE4\xB8", 2, &cp) == 1 && cp >= 0x110000);
+    CHECK(utf8Decode((const unsigned char*)"\xC0\xAF", 2, &cp) == 1 && cp >= 0x110000);
+}
+
+static void testFoldUtf8(void)
+{
+    const char *src = "ÄPFEL Straße ΣΟΦΙΑ \xFF Ж";
+    size_t len = strlen(src);
+    char *dst = malloc(len + 1);
+    foldUtf8(dst, src, len, 1);
+    dst[len] = '\0';
+    CHECK(strcmp(dst, "äpfel straße σοφια \xFF ж") == 0);
+
+    // ascii 为 0 时只折叠非 ASCII 字母
+    foldUtf8(dst, src, len, 0);
+    CHECK(strcmp(dst, "äPFEL Straße σοφια \xFF ж") == 0);
+
+    // 原地折叠
+    strcpy(dst, src);
+    foldUtf8(dst, dst, len, 1);
+    CHECK(strcmp(dst, "äpfel straße σοφια \xFF ж") == 0);
+    free(dst);
+
+    CHECK(hasNonAscii("plain ascii") == 0);
+    CHECK(hasNonAscii("äpfel") == 1);
+}
+
+// 忽略大小写的字面量查找，匹配位置指向原文
+static void testLiteral(void)
+{
+    struct LiteralMatcher lm;
+    char hay[256];
+    // 前面垫上足够长的文本，让 SIMD 的主循环也参与查找
+    memset(hay, '.', 100);
+    strcpy(hay + 100, "ein Äpfel und σοφιας");
+    size_t len = strlen(hay);
+
+    CHECK(literalCompile(&lm, "äPFEL", strlen("äPFEL"), 1) == 0);
+    const char *hit = literalFind(&lm, hay, len);
+    CHECK(hit == hay + 104);
+    literalFree(&lm);
+
+    CHECK(literalCompile(&lm, "ΣΟΦΙΑΣ", strlen("ΣΟΦΙΑΣ"), 1) == 0);
+    hit = literalFind(&lm, hay, len);
+    CHECK(hit != NULL && hit == strstr(hay, "σοφιας"));
+    literalFree(&lm);
+
+    CHECK(literalCompile(&lm, "EIN", 3, 1) == 0);
+    CHECK(literalFind(&lm, hay, len) == hay + 100);
+    literalFree(&lm);
+
+    CHECK(literalCompile(&lm, "EIN", 3, 0) == 0);
+    CHECK(literalFind(&lm, hay, len) == NULL);
+    literalFree(&lm);
+}
+
+int main(void)
+{
+    testFoldCodepoint();
+    testCaseVariants();
+    testUtf8();
+    testFoldUtf8();
+    testLiteral();
+    return checkResult("casefold");
+}
@@ -0,0 +1,158 @@
+//
+// Created by 吨吨 on 2026/10/19.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "check.h"
+#include "decompress.h"
+
+// 解压结果收集到一块不断增长的缓冲区中；limit 不为 0 时收到这么多字节后要求停止
+struct collected
+{
+    char *data;
+    size_t len;
+    size_t cap;
+    size_t limit;
+};
+
+static int collect(void *ctx, const char *data, size_t len)
+{
+    struct collected *c = ctx;
+    if (c->len + len > c->cap)
+    {
+        c->cap = (c->len + len) * 2;
+        c->data = realloc(c->data, c->cap);
+    }
+    memcpy(c->data + c->len, data, len);
+    c->len += len;
+    return c->limit > 0 && c->len >= c->limit;
+}
+
+/* * 用 gzip 格式压缩一段数据
+ *
+ * @param outLen 输出：压缩后的长度
+ * @return 压缩后的数据，调用者释放
+ */
+static char *gzipData(const char *data, size_t len, size_t *outLen)
+{
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    deflateInit2(&zs, 9, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+    size_t cap = deflateBound(&zs, (uLong)len);
+    char *out = malloc(cap);
+    zs.next_in = (Bytef*)data;
+    zs.avail_in = (uInt)len;
+    zs.next_out = (Bytef*)out;
+    zs.avail_out = (uInt)cap;
+    deflate(&zs, Z_FINISH);
+    *outLen = cap - zs.avail_out;
+    deflateEnd(&zs);
+    return out;
+}
+
+/* * 把压缩数据按 blockSize 分块喂给解压器，最后调用 decompressorFinish
+ *
+ * @return decompressorFeed 或 decompressorFinish 的第一个非 0 返回值
+ */
+static int decompressAll(const char *in, size_t len, size_t blockSize, struct collected *c)
+{
+    struct Decompressor *d = decompressorCreate(compressionKind(in, len));
+    if (d == NULL) return -2;
+    int ret = 0;
+    for (size_t pos = 0; pos < len && ret == 0; pos += blockSize)
+    {
+        size_t n = len - pos < blockSize ? len - pos : blockSize;
+        ret = decompressorFeed(d, in + pos, n, collect, c);
+    }
+    if (ret == 0) ret = decompressorFinish(d, collect, c);
+    decompressorFree(d);
+    return ret;
+}
+
+static void testKind(void)
+{
+    CHECK(compressionKind("\x1f\x8b\x08", 3) == COMPRESS_GZIP);
+    CHECK(compressionKind("\x1f", 1) == COMPRESS_NONE);
+    CHECK(compressionKind("plain text", 10) == COMPRESS_NONE);
+}
+
+// 压缩率很高的数据：一小块输入能解压出好几个输出缓冲区的数据，每次喂入的数据用完时 zlib 里往往还有没输出的部分
+static void testTail(void)
+{
+    size_t len = 8 * 1024 * 1024;
+    char *plain = malloc(len);
+    memset(plain, 'a', len);
+    memcpy(plain + len - 5, "TAIL\n", 5);
+    size_t gzLen;
+    char *gz = gzipData(plain, len, &gzLen);
+
+    size_t blockSizes[] = {gzLen, 4096, 1};
+    for (int i = 0; i < 3; i++)
+    {
+        struct collected c = {NULL, 0, 0, 0};
+        CHECK(decompressAll(gz, gzLen, blockSizes[i], &c) == 0);
+        CHECK(c.len == len);
+        CHECK(c.len == len && memcmp(c.data, plain, len) == 0);
+        free(c.data);
+    }
+
+    // 文件被截断、缺了结尾的校验和长度时，已经完整的数据照样全部输出
+    struct collected c = {NULL, 0, 0, 0};
+    CHECK(decompressAll(gz, gzLen - 8, 4096, &c) == 0);
+    CHECK(c.len == len && memcmp(c.data, plain, len) == 0);
+    free(c.data);
+    free(gz);
+    free(plain);
+}
+
+// 多个 gzip 成员首尾相接时依次解压
+static void testMultiMember(void)
+{
+    size_t len1, len2;
+    char *gz1 = gzipData("first member\n", 13, &len1);
+    char *gz2 = gzipData("second member\n", 14, &len2);
+    char *both = malloc(len1 + len2);
+    memcpy(both, gz1, len1);
+    memcpy(both + len1, gz2, len2);
+
+    struct collected c = {NULL, 0, 0, 0};
+    CHECK(decompressAll(both, len1 + len2, len1 + len2, &c) == 0);
+    CHECK(c.len == 27 && memcmp(c.data, "first member\nsecond member\n", 27) == 0);
+    free(c.data);
+    free(both);
+    free(gz1);
+    free(gz2);
+}
+
+// 数据损坏时返回 -1，回调要求停止时返回 1
+static void testErrors(void)
+{
+    size_t len = 1024 * 1024;
+    char *plain = malloc(len);
+    for (size_t i = 0; i < len; i++) plain[i] = (char)('a' + i * 7 % 26);
+    size_t gzLen;
+    char *gz = gzipData(plain, len, &gzLen);
+
+    struct collected c = {NULL, 0, 0, 1000};
+    CHECK(decompressAll(gz, gzLen, gzLen, &c) == 1);
+    free(c.data);
+
+    memset(gz + 10, 0xff, gzLen - 10);
+    c = (struct collected){NULL, 0, 0, 0};
+    CHECK(decompressAll(gz, gzLen, gzLen, &c) == -1);
+    free(c.data);
+    free(gz);
+    free(plain);
+}
+
+int main(void)
+{
+    testKind();
+    testTail();
+    testMultiMember();
+    testErrors();
+    return checkResult("decompress");
+}
@@ -0,0 +1,105 @@
+//
+// Created by 吨吨 on 2026/10/19.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "check.h"
+#include "ignore.h"
+
+static void writeFile(const char *path, const char *content)
+{
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) return;
+    fputs(content, fp);
+    fclose(fp);
+}
+
+// 按相对 root 的路径判断，文件名取最后一段
+static int ignored(const struct IgnoreList *list, const char *root, const char *rel, int isDir)
+{
+    char fullpath[1024];
+    snprintf(fullpath, sizeof(fullpath), "%s/%s", root, rel);
+    const char *name = strrchr(fullpath, '/') + 1;
+    return ignoreMatch(list, fullpath, name, isDir);
+}
+
+int main(void)
+{
+    char root[] = "/tmp/pfind_test_ignoreXXXXXX";
+    if (mkdtemp(root) == NULL)
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+    char sub[64], empty[64], path[128];
+    snprintf(sub, sizeof(sub), "%s/sub", root);
+    snprintf(empty, sizeof(empty), "%s/empty", root);
+    mkdir(sub, 0755);
+    mkdir(empty, 0755);
+
+    snprintf(path, sizeof(path), "%s/.gitignore", root);
+    writeFile(path, "# comment\n"
+                    "\n"
+                    "*.o\n"
+                    "!keep.o\n"
+                    "build/\n"
+                    "/top.txt\n"
+                    "docs/**/*.tmp\n"
+                    "a?c.txt\n"
+                    "[xy].log\n"
+                    "spaced.txt   \r\n"
+                    "\\#hash\n");
+    snprintf(path, sizeof(path), "%s/.gitignore", sub);
+    writeFile(path, "!*.o\nlocal.txt\n");
+    snprintf(path, sizeof(path), "%s/.gitignore", empty);
+    writeFile(path, "# only a comment\n\n");
+
+    struct IgnoreList *rootList = ignoreLoad(root, NULL);
+    CHECK(rootList != NULL);
+    if (rootList == NULL) return checkResult("ignore");
+
+    // 后缀、取反和只匹配目录的规则
+    CHECK(ignored(rootList, root, "main.o", 0) == 1);
+    CHECK(ignored(rootList, root, "main.c", 0) == 0);
+    CHECK(ignored(rootList, root, "keep.o", 0) == 0);
+    CHECK(ignored(rootList, root, "build", 1) == 1);
+    CHECK(ignored(rootList, root, "build", 0) == 0);
+    // 开头有 '/' 的规则只匹配 .gitignore 所在目录下的路径
+    CHECK(ignored(rootList, root, "top.txt", 0) == 1);
+    CHECK(ignored(rootList, root, "src/top.txt", 0) == 0);
+    // "**/" 匹配零层或多层目录
+    CHECK(ignored(rootList, root, "docs/a.tmp", 0) == 1);
+    CHECK(ignored(rootList, root, "docs/a/b/c.tmp", 0) == 1);
+    CHECK(ignored(rootList, root, "src/docs/a.tmp", 0) == 0);
+    // '?' 和 '[...]'
+    CHECK(ignored(rootList, root, "abc.txt", 0) == 1);
+    CHECK(ignored(rootList, root, "abbc.txt", 0) == 0);
+    CHECK(ignored(rootList, root, "x.log", 0) == 1);
+    CHECK(ignored(rootList, root, "z.log", 0) == 0);
+    // 行尾的空格和 "\r" 被去掉，"\#" 表示以 '#' 开头的文件名
+    CHECK(ignored(rootList, root, "spaced.txt", 0) == 1);
+    CHECK(ignored(rootList, root, "#hash", 0) == 1);
+
+    // 子目录的规则优先，没有匹配时再看上层
+    struct IgnoreList *subList = ignoreLoad(sub, rootList);
+    CHECK(subList != NULL);
+    CHECK(ignored(subList, root, "sub/main.o", 0) == 0);
+    CHECK(ignored(subList, root, "sub/local.txt", 0) == 1);
+    CHECK(ignored(subList, root, "sub/build", 1) == 1);
+    CHECK(ignored(rootList, root, "local.txt", 0) == 0);
+
+    // 没有 .gitignore 或者只有注释时不产生规则列表
+    CHECK(ignoreLoad(empty, rootList) == NULL);
+    snprintf(path, sizeof(path), "%s/missing", root);
+    CHECK(ignoreLoad(path, rootList) == NULL);
+
+    ignoreFree(subList);
+    ignoreFree(rootList);
+    snprintf(path, sizeof(path), "rm -rf '%s'", root);
+    if (system(path) != 0) fprintf(stderr, "failed to remove %s\n", root);
+    return checkResult("ignore");
+}
@@ -0,0 +1,123 @@
+//
+// Created by 吨吨 on 2026/10/19.
+//
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "check.h"
+#include "outbuf.h"
+#include "reorder.h"
+
+#define NUM_WORKERS 4
+#define NUM_SEQS 2000
+#define WINDOW 8
+
+// 把输出文件从头读到 buf 中，返回读到的字节数
+static size_t readBack(FILE *fp, char *buf, size_t cap)
+{
+    rewind(fp);
+    size_t n = fread(buf, 1, cap - 1, fp);
+    buf[n] = '\0';
+    return n;
+}
+
+// 乱序提交：序号 0 到来之前什么都不写出，之后连同已就绪的结果一起写出，空结果也要占一个序号
+static void testOutOfOrder(void)
+{
+    FILE *fp = tmpfile();
+    outInit(fp);
+    struct ReorderBuffer rb;
+    CHECK(reorderInit(&rb, 4) == 0);
+
+    char buf[64];
+    reorderSubmit(&rb, 2, "c", 1);
+    reorderSubmit(&rb, 1, "", 0);
+    reorderSubmit(&rb, 3, "d", 1);
+    CHECK(readBack(fp, buf, sizeof(buf)) == 0);
+
+    reorderSubmit(&rb, 0, "a", 1);
+    readBack(fp, buf, sizeof(buf));
+    CHECK(strcmp(buf, "acd") == 0);
+    CHECK(rb.nextEmit == 4);
+
+    // 窗口转过一圈后槽位可以重新使用
+    reorderSubmit(&rb, 5, "f", 1);
+    reorderSubmit(&rb, 4, "e", 1);
+    readBack(fp, buf, sizeof(buf));
+    CHECK(strcmp(buf, "acdef") == 0);
+
+    reorderDestroy(&rb);
+    fclose(fp);
+}
+
+struct workerArgs
+{
+    struct ReorderBuffer *rb;
+    atomic_ullong *next;
+};
+
+// 每个线程领一个序号，等窗口有空位后随机耽搁一会儿再提交，模拟完成顺序与遍历顺序不同的任务
+static void *submitWorker(void *arg)
+{
+    struct workerArgs *wa = arg;
+    unsigned int seed = (unsigned int)(size_t)pthread_self();
+    while (1)
+    {
+        unsigned long long seq = atomic_fetch_add(wa->next, 1);
+        if (seq >= NUM_SEQS) break;
+        reorderReserve(wa->rb, seq);
+        if (rand_r(&seed) % 4 == 0) usleep(rand_r(&seed) % 200);
+        char line[32];
+        int len = snprintf(line, sizeof(line), "%llu\n", seq);
+        reorderSubmit(wa->rb, seq, line, (size_t)len);
+    }
+    return NULL;
+}
+
+// 多个线程并发提交，写出的序号必须连续且有序
+static void testConcurrent(void)
+{
+    FILE *fp = tmpfile();
+    outInit(fp);
+    struct ReorderBuffer rb;
+    CHECK(reorderInit(&rb, WINDOW) == 0);
+
+    atomic_ullong next = 0;
+    struct workerArgs wa = {&rb, &next};
+    pthread_t tids[NUM_WORKERS];
+    for (int i = 0; i < NUM_WORKERS; i++) pthread_create(&tids[i], NULL, submitWorker, &wa);
+    for (int i = 0; i < NUM_WORKERS; i++) pthread_join(tids[i], NULL);
+    CHECK(rb.nextEmit == NUM_SEQS);
+
+    size_t cap = NUM_SEQS * 8;
+    char *buf = malloc(cap);
+    readBack(fp, buf, cap);
+    char *p = buf;
+    for (unsigned long long seq = 0; seq < NUM_SEQS; seq++)
+    {
+        char *end;
+        unsigned long long got = strtoull(p, &end, 10);
+        if (end == p || *end != '\n' || got != seq)
+        {
+            CHECK(got == seq);
+            break;
+        }
+        p = end + 1;
+    }
+    CHECK(*p == '\0');
+
+    free(buf);
+    reorderDestroy(&rb);
+    fclose(fp);
+}
+
+int main(void)
+{
+    testOutOfOrder();
+    testConcurrent();
+    return checkResult("reorder");
+}
@@ -0,0 +1,135 @@
+//
+// Created by 吨吨 on 2026/10/19.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "check.h"
+#include "trigram.h"
+
+// 登记一个文件，不能沿用旧索引时提取内容中的三字节组
+static void addFile(struct IndexBuilder *b, const char *path, uint64_t ino, int64_t mtimeNs, const char *content)
+{
+    uint32_t id = indexBuilderAddFile(b, path);
+    indexBuilderSetFileInfo(b, id, ino, strlen(content), mtimeNs);
+    if (indexBuilderReuseFile(b, id)) return;
+
+    uint32_t *trigrams = NULL;
+    size_t count = 0, cap = 0;
+    struct TrigramWindow w = {0, 0};
+    collectTrigrams(&w, content, strlen(content), &trigrams, &count, &cap);
+    count = uniqueTrigrams(trigrams, count);
+    indexBuilderAddTrigrams(b, id, trigrams, count);
+    free(trigrams);
+}
+
+/* * 查询索引，把候选文件的路径按文件编号顺序用 ',' 连起来
+ *
+ * @return indexQuery 的返回值
+ */
+static int query(const struct IndexReader *r, const char *literal, char *out, size_t size)
+{
+    uint64_t n = indexNumFiles(r);
+    unsigned char *candidates = calloc(n ? n : 1, 1);
+    int filtered = indexQuery(r, literal, strlen(literal), candidates);
+    out[0] = '\0';
+    for (uint64_t i = 0; i < n; i++)
+    {
+        if (!candidates[i]) continue;
+        if (out[0] != '\0') strncat(out, ",", size - strlen(out) - 1);
+        strncat(out, indexFilePath(r, i), size - strlen(out) - 1);
+    }
+    free(candidates);
+    return filtered;
+}
+
+// 分块提取和一次提取得到的三字节组相同，跨块的三字节组不会丢
+static void testCollectAcrossBlocks(void)
+{
+    const char *text = "Hello, World";
+    uint32_t *whole = NULL, *split = NULL;
+    size_t wholeCount = 0, wholeCap = 0, splitCount = 0, splitCap = 0;
+
+    struct TrigramWindow w = {0, 0};
+    collectTrigrams(&w, text, strlen(text), &whole, &wholeCount, &wholeCap);
+    w = (struct TrigramWindow){0, 0};
+    for (size_t i = 0; text[i] != '\0'; i++) collectTrigrams(&w, text + i, 1, &split, &splitCount, &splitCap);
+
+    CHECK(wholeCount == strlen(text) - 2);
+    CHECK(splitCount == wholeCount);
+    CHECK(splitCount == wholeCount && memcmp(whole, split, sizeof(uint32_t) * wholeCount) == 0);
+
+    // 三字节组按 ASCII 小写折叠
+    uint32_t *lower = NULL;
+    size_t lowerCount = 0, lowerCap = 0;
+    w = (struct TrigramWindow){0, 0};
+    collectTrigrams(&w, "hello, world", 12, &lower, &lowerCount, &lowerCap);
+    CHECK(lowerCount == wholeCount && memcmp(whole, lower, sizeof(uint32_t) * wholeCount) == 0);
+
+    free(whole);
+    free(split);
+    free(lower);
+}
+
+static void testBuildAndUpdate(void)
+{
+    char indexPath[64];
+    snprintf(indexPath, sizeof(indexPath), "/tmp/pfind_test_%d.idx", (int)getpid());
+    char result[256];
+
+    struct IndexBuilder *b = indexBuilderCreate(indexPath);
+    CHECK(b != NULL);
+    addFile(b, "a.c", 1, 100, "hello world");
+    addFile(b, "b.c", 2, 100, "HELLO there");
+    addFile(b, "c.c", 3, 100, "goodbye");
+    CHECK(indexBuilderFinish(b, NULL) == 0);
+
+    struct IndexReader *r = indexOpen(indexPath);
+    CHECK(r != NULL);
+    if (r == NULL) return;
+    CHECK(indexNumFiles(r) == 3);
+    CHECK(strcmp(indexFilePath(r, 2), "c.c") == 0);
+    CHECK(indexFile(r, 1)->ino == 2 && indexFile(r, 1)->size == 11 && indexFile(r, 1)->mtimeNs == 100);
+
+    CHECK(query(r, "hello", result, sizeof(result)) == 1 && strcmp(result, "a.c,b.c") == 0);
+    CHECK(query(r, "World", result, sizeof(result)) == 1 && strcmp(result, "a.c") == 0);
+    CHECK(query(r, "lo w", result, sizeof(result)) == 1 && strcmp(result, "a.c") == 0);
+    CHECK(query(r, "hello there", result, sizeof(result)) == 1 && strcmp(result, "b.c") == 0);
+    CHECK(query(r, "xyz", result, sizeof(result)) == 1 && strcmp(result, "") == 0);
+    // 不到 3 个字节无法过滤
+    CHECK(query(r, "he", result, sizeof(result)) == 0);
+
+    // 增量更新：a.c 的 inode、大小和修改时间都没变，沿用旧记录而不提取传进去的内容；
+    // b.c 修改过，c.c 已删除，d.c 是新文件
+    b = indexBuilderCreate(indexPath);
+    CHECK(b != NULL && indexBuilderSetBase(b, r) == 0);
+    addFile(b, "a.c", 1, 100, "stale stuff");
+    addFile(b, "b.c", 2, 200, "nothing");
+    addFile(b, "d.c", 4, 100, "hello again");
+    CHECK(indexBuilderReusedCount(b) == 1);
+    CHECK(indexBuilderFileCount(b) == 3);
+    CHECK(indexBuilderFinish(b, NULL) == 0);
+    indexClose(r);
+
+    r = indexOpen(indexPath);
+    CHECK(r != NULL);
+    if (r == NULL) return;
+    CHECK(indexNumFiles(r) == 3);
+    CHECK(query(r, "hello", result, sizeof(result)) == 1 && strcmp(result, "a.c,d.c") == 0);
+    CHECK(query(r, "world", result, sizeof(result)) == 1 && strcmp(result, "a.c") == 0);
+    CHECK(query(r, "stale", result, sizeof(result)) == 1 && strcmp(result, "") == 0);
+    CHECK(query(r, "nothing", result, sizeof(result)) == 1 && strcmp(result, "b.c") == 0);
+    CHECK(query(r, "goodbye", result, sizeof(result)) == 1 && strcmp(result, "") == 0);
+    CHECK(indexFile(r, 1)->mtimeNs == 200);
+    indexClose(r);
+    unlink(indexPath);
+}
+
+int main(void)
+{
+    testCollectAcrossBlocks();
+    testBuildAndUpdate();
+    return checkResult("trigram");
+}
@@ -2,10 +2,12 @@
 // Created by 吨吨 on 2025/6/9.
 //
 #include "threadpool.h"
+#include <errno.h>
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/time.h>
 
@@ -16,11 +18,14 @@ void *manager(void *arg);
 void threadDestroy(struct ThreadPool *pool);
 struct ThreadPool* ThreadPoolCreate(int max, int min, int cap);
 int ThreadPoolAdd(struct ThreadPool *pool, void (*func)(void *arg), void *arg);
+int ThreadPoolTryAdd(struct ThreadPool *pool, void (*func)(void *arg), void *arg);
 int getThreadLiveNum(struct ThreadPool *pool);
 int getThreadBusyNum(struct ThreadPool *pool);
 int ThreadPoolDestroy (struct ThreadPool *pool);
+void ThreadPoolWait(struct ThreadPool *pool);
 void ThreadPoolWaitAndDestroy(struct ThreadPool *pool);
 int getThreadQueueSize(struct ThreadPool *pool);
+int getThreadQueuePeak(struct ThreadPool *pool);
 
 struct timeval start_time, end_time;
 
@@ -38,6 +43,8 @@ struct ThreadPool
     int QueueSize;
     int QueueFront;
     int QueueRear;
+    int QueuePeak; // 队列里同时排队的任务数的最大值
+    int pendingNum; // 已经加入但还没有执行完的任务数（排队的加上正在执行的），受 mutex_pool 保护
 
     // 线程
     pthread_t managerTid;
@@ -55,6 +62,8 @@ struct ThreadPool
     pthread_mutex_t mutex_busy;
     pthread_cond_t not_empty;
     pthread_cond_t not_full;
+    pthread_cond_t manager_wake; // 销毁时唤醒管理线程，不必等它睡满一个周期
+    pthread_cond_t all_done;     // pendingNum 降到 0 时广播，ThreadPoolWait 在它上面等待
 
     // 销毁
     int shutdown;
@@ -66,7 +75,7 @@ struct ThreadPool* ThreadPoolCreate(int max, int min, int cap)
     // 记录开始时间
     gettimeofday(&start_time, NULL);
 
-    struct ThreadPool *pool = malloc(sizeof(struct ThreadPool));
+    struct ThreadPool *pool = calloc(1, sizeof(struct ThreadPool));
     do
     {
         if (pool == NULL)
@@ -86,6 +95,8 @@ struct ThreadPool* ThreadPoolCreate(int max, int min, int cap)
         pool->QueueSize = 0;
         pool->QueueFront = 0;
         pool->QueueRear = 0;
+        pool->QueuePeak = 0;
+        pool->pendingNum = 0;
 
         pool->max = max;
         pool->min = min;
@@ -97,7 +108,9 @@ struct ThreadPool* ThreadPoolCreate(int max, int min, int cap)
         if (pthread_mutex_init(&pool->mutex_pool, NULL) != 0 ||
             pthread_mutex_init(&pool->mutex_busy, NULL) != 0 ||
             pthread_cond_init(&pool->not_empty, NULL) != 0 ||
-            pthread_cond_init(&pool->not_full, NULL) != 0)
+            pthread_cond_init(&pool->not_full, NULL) != 0 ||
+            pthread_cond_init(&pool->manager_wake, NULL) != 0 ||
+            pthread_cond_init(&pool->all_done, NULL) != 0)
         {
             printf("lock can not be inited\n");
             break;
@@ -153,6 +166,7 @@ int ThreadPoolDestroy (struct ThreadPool *pool)
     // 可以用pthread_cond_broadcast来唤醒所有线程
     pthread_cond_broadcast(&pool->not_empty);
     pthread_cond_broadcast(&pool->not_full);
+    pthread_cond_signal(&pool->manager_wake);
 
     // 等待管理线程退出
     pthread_join(pool->managerTid, NULL);
@@ -170,6 +184,8 @@ int ThreadPoolDestroy (struct ThreadPool *pool)
     pthread_mutex_destroy(&pool->mutex_busy);
     pthread_cond_destroy(&pool->not_empty);
     pthread_cond_destroy(&pool->not_full);
+    pthread_cond_destroy(&pool->manager_wake);
+    pthread_cond_destroy(&pool->all_done);
 
     if (pool->taskQueue)
     {
@@ -229,6 +245,8 @@ int ThreadPoolAdd(struct ThreadPool *pool, void (*func)(void *arg), void *arg)
     pool->taskQueue[pool->QueueRear] = task;
     pool->QueueRear = (pool->QueueRear + 1) % pool->QueueCapacity;
     pool->QueueSize += 1;
+    pool->pendingNum += 1;
+    if (pool->QueueSize > pool->QueuePeak) pool->QueuePeak = pool->QueueSize;
 
     pthread_mutex_unlock(&pool->mutex_pool);
     pthread_cond_signal(&pool->not_empty);
@@ -236,6 +254,54 @@ int ThreadPoolAdd(struct ThreadPool *pool, void (*func)(void *arg), void *arg)
     return 0; // 成功添加任务
 }
 
+// 尝试添加任务，队列已满时不等待直接返回
+// 工作线程在任务中再添加任务时使用：如果所有工作线程都阻塞在满队列上，就没有线程去取任务了
+int ThreadPoolTryAdd(struct ThreadPool *pool, void (*func)(void *arg), void *arg)
+{
+    if (pool == NULL || func == NULL)
+    {
+        return -1; // 线程池或任务函数不存在
+    }
+
+    pthread_mutex_lock(&pool->mutex_pool);
+    if (pool->shutdown || pool->QueueSize >= pool->QueueCapacity)
+    {
+        pthread_mutex_unlock(&pool->mutex_pool);
+        return -1; // 线程池已关闭或任务队列已满
+    }
+
+    pool->taskQueue[pool->QueueRear].func = func;
+    pool->taskQueue[pool->QueueRear].arg = arg;
+    pool->QueueRear = (pool->QueueRear + 1) % pool->QueueCapacity;
+    pool->QueueSize += 1;
+    pool->pendingNum += 1;
+    if (pool->QueueSize > pool->QueuePeak) pool->QueuePeak = pool->QueueSize;
+
+    pthread_mutex_unlock(&pool->mutex_pool);
+    pthread_cond_signal(&pool->not_empty);
+
+    return 0; // 成功添加任务
+}
+
+// 等待所有任务完成，线程池保持可用
+// pendingNum 在加入任务时增加、任务执行完后才减少，两者都在 mutex_pool 之内，
+// 所以正在执行的任务再加入的任务也会被等到
+void ThreadPoolWait(struct ThreadPool *pool)
+{
+    if (pool == NULL)
+    {
+        printf("pool not exist\n");
+        return;
+    }
+
+    pthread_mutex_lock(&pool->mutex_pool);
+    while (pool->pendingNum > 0)
+    {
+        pthread_cond_wait(&pool->all_done, &pool->mutex_pool);
+    }
+    pthread_mutex_unlock(&pool->mutex_pool);
+}
+
 // 等待所有任务完成再销毁线程池函数
 void ThreadPoolWaitAndDestroy(struct ThreadPool *pool)
 {
@@ -246,10 +312,7 @@ void ThreadPoolWaitAndDestroy(struct ThreadPool *pool)
     }
 
     // 等待所有任务完成
-    while (getThreadBusyNum(pool) > 0 || getThreadQueueSize(pool) > 0)
-    {
-        usleep(1000); // 等待1毫秒
-    }
+    ThreadPoolWait(pool);
 
     // 等待所有工作线程退出后就可以销毁线程池
     ThreadPoolDestroy(pool);
@@ -300,6 +363,15 @@ int getThreadQueueSize(struct ThreadPool *pool)
     return queueSize;
 }
 
+// 获取任务队列曾经达到的最大长度
+int getThreadQueuePeak(struct ThreadPool *pool)
+{
+    pthread_mutex_lock(&pool->mutex_pool);
+    int queuePeak = pool->QueuePeak;
+    pthread_mutex_unlock(&pool->mutex_pool);
+    return queuePeak;
+}
+
 /** * 工作线程函数，循环从任务队列中取出任务并执行
  * 具体思路：
  * 1.不断循环，直到线程池被销毁
@@ -343,18 +415,24 @@ void *worker(void *arg)
         pool->QueueFront = (pool->QueueFront + 1) % pool->QueueCapacity;
         pool->QueueSize -= 1;
 
-        pthread_mutex_unlock(&pool->mutex_pool);
-        pthread_cond_signal(&pool->not_full);
-
         pthread_mutex_lock(&pool->mutex_busy);
         pool->busyNum += 1;
         pthread_mutex_unlock(&pool->mutex_busy);
 
+        pthread_mutex_unlock(&pool->mutex_pool);
+        pthread_cond_signal(&pool->not_full);
+
         task.func(task.arg);
 
         pthread_mutex_lock(&pool->mutex_busy);
         pool->busyNum -= 1;
         pthread_mutex_unlock(&pool->mutex_busy);
+
+        // 任务执行完才算完成，它在执行中加入的任务此前已经计入 pendingNum
+        pthread_mutex_lock(&pool->mutex_pool);
+        pool->pendingNum -= 1;
+        if (pool->pendingNum == 0) pthread_cond_broadcast(&pool->all_done);
+        pthread_mutex_unlock(&pool->mutex_pool);
     }
     return NULL;
 }
@@ -372,11 +450,22 @@ void *worker(void *arg)
 void *manager(void *arg)
 {
     struct ThreadPool *pool = (struct ThreadPool*) arg;
-    while (!pool->shutdown)
+    while (1)
     {
-        sleep(3);
-
+        // 每 3 秒检查一次，销毁时被提前唤醒
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += 3;
         pthread_mutex_lock(&pool->mutex_pool);
+        while (!pool->shutdown &&
+               pthread_cond_timedwait(&pool->manager_wake, &pool->mutex_pool, &deadline) != ETIMEDOUT)
+        {
+        }
+        if (pool->shutdown)
+        {
+            pthread_mutex_unlock(&pool->mutex_pool);
+            break;
+        }
         int liveNum = pool->liveNum;
         int taskSize = pool->QueueSize;
         int maxNum = pool->max;
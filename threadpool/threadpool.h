@@ -12,10 +12,13 @@ void *manager(void *arg);
 void threadDestroy(struct ThreadPool *pool);
 struct ThreadPool* ThreadPoolCreate(int max, int min, int cap);
 int ThreadPoolAdd(struct ThreadPool *pool, void (*func)(void *arg), void *arg);
+int ThreadPoolTryAdd(struct ThreadPool *pool, void (*func)(void *arg), void *arg);
 int getThreadLiveNum(struct ThreadPool *pool);
 int getThreadBusyNum(struct ThreadPool *pool);
 int ThreadPoolDestroy (struct ThreadPool *pool);
+void ThreadPoolWait(struct ThreadPool *pool);
 void ThreadPoolWaitAndDestroy(struct ThreadPool *pool);
 int getThreadQueueSize(struct ThreadPool *pool);
+int getThreadQueuePeak(struct ThreadPool *pool);
 
 #endif //THREADPOOL_H
@@ -0,0 +1,873 @@
+//
+// Created by 吨吨 on 2026/10/19.
+//
+#include "trigram.h"
+#include "threadpool.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// 内存中最多攒这么多 (trigram, fileId) 对，超过后排序写入临时文件，最后再归并
+#define INDEX_PAIRS_LIMIT ((size_t)32 << 20)
+// 写出倒排列表时按三字节组的首字节分段，每段是线程池中的一个任务
+#define INDEX_RANGES 256
+
+struct indexFileEntry
+{
+    char *path;
+    uint64_t ino;
+    uint64_t size;
+    int64_t mtimeNs;
+};
+
+// 旧索引中的文件，按路径排序后用于二分查找
+struct baseFileEntry
+{
+    const char *path;
+    uint32_t id;
+};
+
+struct IndexBuilder
+{
+    char *indexPath;
+
+    struct indexFileEntry *files;
+    uint32_t numFiles;
+    uint32_t filesCap;
+
+    uint64_t *pairs; // 高 32 位是 trigram，低 32 位是文件编号，排序后即为按 trigram 分组的倒排列表
+    size_t numPairs;
+    size_t pairsCap;
+    int numRuns;     // 已经写入临时文件的有序段数量
+
+    // 增量更新：未变化的文件直接沿用旧索引中的倒排列表，只是换成新的文件编号
+    const struct IndexReader *base;
+    struct baseFileEntry *baseOrder;
+    uint32_t *oldToNew; // 旧编号到新编号，UINT32_MAX 表示文件已删除或已修改
+    uint32_t numReused;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t rangeDone;
+};
+
+// 一段三字节组 [lo, hi) 的归并结果
+struct compactRange
+{
+    struct IndexBuilder *b;
+    uint32_t lo;
+    uint32_t hi;
+    unsigned char *postings; // 本段的倒排列表，偏移相对本段开头
+    size_t len;
+    size_t cap;
+    struct IndexTrigramRecord *table;
+    size_t tableLen;
+    size_t tableCap;
+    int failed;
+    int done;
+};
+
+struct IndexReader
+{
+    void *map;
+    size_t mapLen;
+    const struct IndexHeader *header;
+    const struct IndexFileRecord *files;
+    const char *paths;
+    const unsigned char *postings;
+    const struct IndexTrigramRecord *trigrams;
+};
+
+static uint32_t *decodePostings(const struct IndexReader *r, const struct IndexTrigramRecord *rec);
+
+static unsigned char foldLower(unsigned char c)
+{
+    return (c >= 'A' && c <= 'Z') ? (unsigned char)(c + 32) : c;
+}
+
+/* * 从一块数据中提取所有三字节组，追加到 out
+ * 可以分块调用，w 保存了上一块末尾的两个字节
+ *
+ * @param w 跨块窗口，第一次调用前清零
+ * @param data 数据
+ * @param len 数据长度
+ * @param out 输入输出：三字节组数组，容量不够时扩容
+ * @param count 输入输出：数组中的元素个数
+ * @param cap 输入输出：数组容量
+ */
+void collectTrigrams(struct TrigramWindow *w, const char *data, size_t len, uint32_t **out, size_t *count, size_t *cap)
+{
+    if (*count + len > *cap)
+    {
+        size_t newCap = *cap ? *cap : 4096;
+        while (newCap < *count + len) newCap *= 2;
+        *out = realloc(*out, sizeof(uint32_t) * newCap);
+        *cap = newCap;
+    }
+
+    uint32_t last = w->last;
+    int have = w->have;
+    uint32_t *dst = *out + *count;
+    for (size_t i = 0; i < len; i++)
+    {
+        last = ((last << 8) | foldLower((unsigned char)data[i])) & 0xffffff;
+        if (have < 2)
+        {
+            have++;
+            continue;
+        }
+        *dst++ = last;
+    }
+    *count = (size_t)(dst - *out);
+    w->last = last;
+    w->have = have;
+}
+
+static int compareU32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+// 排序并去重，返回去重后的个数
+size_t uniqueTrigrams(uint32_t *trigrams, size_t count)
+{
+    if (count == 0) return 0;
+    qsort(trigrams, count, sizeof(uint32_t), compareU32);
+    size_t n = 1;
+    for (size_t i = 1; i < count; i++)
+    {
+        if (trigrams[i] != trigrams[n - 1]) trigrams[n++] = trigrams[i];
+    }
+    return n;
+}
+
+// 按 16 位一组做 4 趟 LSD 基数排序，比 qsort 快得多
+static void radixSort64(uint64_t *keys, size_t n)
+{
+    uint64_t *tmp = malloc(sizeof(uint64_t) * n);
+    size_t *count = malloc(sizeof(size_t) * 65536);
+    if (tmp == NULL || count == NULL)
+    {
+        free(tmp);
+        free(count);
+        return;
+    }
+
+    uint64_t *src = keys, *dst = tmp;
+    for (int shift = 0; shift < 64; shift += 16)
+    {
+        memset(count, 0, sizeof(size_t) * 65536);
+        for (size_t i = 0; i < n; i++) count[(src[i] >> shift) & 0xffff]++;
+        size_t sum = 0;
+        for (size_t d = 0; d < 65536; d++)
+        {
+            size_t c = count[d];
+            count[d] = sum;
+            sum += c;
+        }
+        for (size_t i = 0; i < n; i++) dst[count[(src[i] >> shift) & 0xffff]++] = src[i];
+        uint64_t *t = src;
+        src = dst;
+        dst = t;
+    }
+    // 趟数为偶数，结果已经回到 keys 中
+    free(tmp);
+    free(count);
+}
+
+static void runPath(const struct IndexBuilder *b, int run, char *buf, size_t size)
+{
+    snprintf(buf, size, "%s.run%d", b->indexPath, run);
+}
+
+struct IndexBuilder *indexBuilderCreate(const char *indexPath)
+{
+    struct IndexBuilder *b = calloc(1, sizeof(struct IndexBuilder));
+    if (b == NULL) return NULL;
+    b->indexPath = strdup(indexPath);
+    pthread_mutex_init(&b->mutex, NULL);
+    pthread_cond_init(&b->rangeDone, NULL);
+    return b;
+}
+
+static int compareBaseFile(const void *a, const void *b)
+{
+    return strcmp(((const struct baseFileEntry*)a)->path, ((const struct baseFileEntry*)b)->path);
+}
+
+/* * 设置旧索引，之后登记的文件如果在旧索引中有记录且没有变化，可以直接沿用旧的倒排列表
+ * 旧索引在 indexBuilderFinish 之前不能关闭
+ *
+ * @param b 索引构建器
+ * @param base 旧索引
+ * @return 0 成功，-1 内存不足
+ */
+int indexBuilderSetBase(struct IndexBuilder *b, const struct IndexReader *base)
+{
+    uint64_t n = indexNumFiles(base);
+    b->baseOrder = malloc(sizeof(struct baseFileEntry) * (n ? n : 1));
+    b->oldToNew = malloc(sizeof(uint32_t) * (n ? n : 1));
+    if (b->baseOrder == NULL || b->oldToNew == NULL) return -1;
+
+    for (uint64_t i = 0; i < n; i++)
+    {
+        b->baseOrder[i].path = indexFilePath(base, i);
+        b->baseOrder[i].id = (uint32_t)i;
+        b->oldToNew[i] = UINT32_MAX;
+    }
+    qsort(b->baseOrder, n, sizeof(struct baseFileEntry), compareBaseFile);
+    b->base = base;
+    return 0;
+}
+
+/* * 判断一个文件能否沿用旧索引：同一路径在旧索引中存在，并且 inode、大小和修改时间都没变
+ * 需要先用 indexBuilderSetFileInfo 记录文件当前的状态
+ *
+ * @param b 索引构建器
+ * @param fileId 文件编号
+ * @return 1 已沿用，调用者不需要再读取文件；0 需要重新提取三字节组
+ */
+int indexBuilderReuseFile(struct IndexBuilder *b, uint32_t fileId)
+{
+    if (b->base == NULL) return 0;
+
+    int reused = 0;
+    pthread_mutex_lock(&b->mutex);
+    struct baseFileEntry key = {b->files[fileId].path, 0};
+    struct baseFileEntry *found = bsearch(&key, b->baseOrder, indexNumFiles(b->base),
+                                          sizeof(struct baseFileEntry), compareBaseFile);
+    if (found)
+    {
+        const struct IndexFileRecord *old = indexFile(b->base, found->id);
+        if (old->ino == b->files[fileId].ino && old->size == b->files[fileId].size &&
+            old->mtimeNs == b->files[fileId].mtimeNs)
+        {
+            b->oldToNew[found->id] = fileId;
+            b->numReused++;
+            reused = 1;
+        }
+    }
+    pthread_mutex_unlock(&b->mutex);
+    return reused;
+}
+
+// 沿用旧索引的文件数
+uint32_t indexBuilderReusedCount(struct IndexBuilder *b)
+{
+    pthread_mutex_lock(&b->mutex);
+    uint32_t n = b->numReused;
+    pthread_mutex_unlock(&b->mutex);
+    return n;
+}
+
+// 已登记的文件数
+uint32_t indexBuilderFileCount(struct IndexBuilder *b)
+{
+    pthread_mutex_lock(&b->mutex);
+    uint32_t n = b->numFiles;
+    pthread_mutex_unlock(&b->mutex);
+    return n;
+}
+
+// 登记一个文件，返回文件编号；只在遍历线程中调用，编号按遍历顺序分配
+uint32_t indexBuilderAddFile(struct IndexBuilder *b, const char *path)
+{
+    pthread_mutex_lock(&b->mutex);
+    if (b->numFiles == b->filesCap)
+    {
+        b->filesCap = b->filesCap ? b->filesCap * 2 : 1024;
+        b->files = realloc(b->files, sizeof(struct indexFileEntry) * b->filesCap);
+    }
+    uint32_t id = b->numFiles++;
+    memset(&b->files[id], 0, sizeof(struct indexFileEntry));
+    b->files[id].path = strdup(path);
+    pthread_mutex_unlock(&b->mutex);
+    return id;
+}
+
+void indexBuilderSetFileInfo(struct IndexBuilder *b, uint32_t fileId, uint64_t ino, uint64_t size, int64_t mtimeNs)
+{
+    pthread_mutex_lock(&b->mutex);
+    b->files[fileId].ino = ino;
+    b->files[fileId].size = size;
+    b->files[fileId].mtimeNs = mtimeNs;
+    pthread_mutex_unlock(&b->mutex);
+}
+
+/* * 把内存中的对排序后写入一个临时有序段
+ * 调用者持有锁，写出期间其他线程需要等待，但每 INDEX_PAIRS_LIMIT 个对才发生一次
+ */
+static int spillRun(struct IndexBuilder *b)
+{
+    char path[4096];
+    runPath(b, b->numRuns, path, sizeof(path));
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) return -1;
+
+    radixSort64(b->pairs, b->numPairs);
+    size_t written = fwrite(b->pairs, sizeof(uint64_t), b->numPairs, fp);
+    fclose(fp);
+    if (written != b->numPairs) return -1;
+
+    b->numRuns++;
+    b->numPairs = 0;
+    return 0;
+}
+
+/* * 记录一个文件包含的三字节组（已去重），可以在多个工作线程中同时调用
+ *
+ * @param b 索引构建器
+ * @param fileId 文件编号
+ * @param trigrams 三字节组数组
+ * @param count 个数
+ */
+void indexBuilderAddTrigrams(struct IndexBuilder *b, uint32_t fileId, uint32_t *trigrams, size_t count)
+{
+    pthread_mutex_lock(&b->mutex);
+    if (b->numPairs + count > INDEX_PAIRS_LIMIT && b->numPairs > 0)
+    {
+        if (spillRun(b) != 0)
+        {
+            printf("[warning] Fail to write temporary index run for %s\n", b->indexPath);
+        }
+    }
+    if (b->numPairs + count > b->pairsCap)
+    {
+        size_t newCap = b->pairsCap ? b->pairsCap : 65536;
+        while (newCap < b->numPairs + count) newCap *= 2;
+        b->pairs = realloc(b->pairs, sizeof(uint64_t) * newCap);
+        b->pairsCap = newCap;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        b->pairs[b->numPairs++] = ((uint64_t)trigrams[i] << 32) | fileId;
+    }
+    pthread_mutex_unlock(&b->mutex);
+}
+
+// 归并时的一路输入：临时有序段文件，或者内存中的数组
+// 只读取 [lower_bound(lo), 第一个 trigram >= hi 的位置) 这一段
+struct pairSource
+{
+    FILE *fp;
+    const uint64_t *mem;
+    size_t pos;
+    size_t end;
+    uint64_t limit; // 第一个不属于本段的键
+    uint64_t head;
+    int valid;
+};
+
+static void sourceAdvance(struct pairSource *src)
+{
+    src->valid = 0;
+    if (src->pos >= src->end) return;
+    if (src->fp)
+    {
+        if (fread(&src->head, sizeof(uint64_t), 1, src->fp) != 1) return;
+    }
+    else
+    {
+        src->head = src->mem[src->pos];
+    }
+    src->pos++;
+    src->valid = src->head < src->limit;
+}
+
+static uint64_t sourceAt(const struct pairSource *src, size_t i)
+{
+    if (src->fp == NULL) return src->mem[i];
+    uint64_t v = 0;
+    if (pread(fileno(src->fp), &v, sizeof(v), (off_t)(i * sizeof(v))) != (ssize_t)sizeof(v)) return UINT64_MAX;
+    return v;
+}
+
+// 二分查找到第一个不小于 key 的位置，从那里开始读
+static void sourceSeek(struct pairSource *src, uint64_t key, uint64_t limit)
+{
+    size_t lo = 0, hi = src->end;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (sourceAt(src, mid) < key) lo = mid + 1;
+        else hi = mid;
+    }
+    src->pos = lo;
+    src->limit = limit;
+    if (src->fp) fseeko(src->fp, (off_t)(lo * sizeof(uint64_t)), SEEK_SET);
+    sourceAdvance(src);
+}
+
+static void appendVarint(struct compactRange *range, uint64_t v)
+{
+    if (range->len + 10 > range->cap)
+    {
+        range->cap = range->cap ? range->cap * 2 : 65536;
+        range->postings = realloc(range->postings, range->cap);
+    }
+    while (v >= 0x80)
+    {
+        range->postings[range->len++] = (unsigned char)((v & 0x7f) | 0x80);
+        v >>= 7;
+    }
+    range->postings[range->len++] = (unsigned char)v;
+}
+
+static void appendId(uint32_t **ids, size_t *len, size_t *cap, uint32_t id)
+{
+    if (*len == *cap)
+    {
+        *cap = *cap ? *cap * 2 : 1024;
+        *ids = realloc(*ids, sizeof(uint32_t) * *cap);
+    }
+    (*ids)[(*len)++] = id;
+}
+
+/* * 生成一段三字节组 [lo, hi) 的倒排列表，在线程池中执行
+ * 新文件的对来自内存和临时有序段的多路归并；更新索引时，旧索引中同一三字节组的列表
+ * 按新编号重映射（已删除或已修改的文件被丢掉）后与之合并
+ *
+ * @param arg struct compactRange 指针
+ */
+static void compactRangeTask(void *arg)
+{
+    struct compactRange *range = arg;
+    struct IndexBuilder *b = range->b;
+    uint64_t lowKey = (uint64_t)range->lo << 32;
+    uint64_t highKey = (uint64_t)range->hi << 32;
+
+    struct pairSource *sources = calloc((size_t)b->numRuns + 1, sizeof(struct pairSource));
+    int numSources = 0;
+    for (int i = 0; i < b->numRuns && sources; i++)
+    {
+        char path[4096];
+        runPath(b, i, path, sizeof(path));
+        FILE *fp = fopen(path, "rb");
+        struct stat st;
+        if (fp == NULL || fstat(fileno(fp), &st) != 0)
+        {
+            if (fp) fclose(fp);
+            range->failed = 1;
+            continue;
+        }
+        sources[numSources].fp = fp;
+        sources[numSources].end = (size_t)st.st_size / sizeof(uint64_t);
+        sourceSeek(&sources[numSources++], lowKey, highKey);
+    }
+    if (sources)
+    {
+        sources[numSources].mem = b->pairs;
+        sources[numSources].end = b->numPairs;
+        sourceSeek(&sources[numSources++], lowKey, highKey);
+    }
+    else
+    {
+        range->failed = 1;
+    }
+
+    // 旧索引中属于本段的三字节组
+    size_t baseNext = 0, baseEnd = 0;
+    if (b->base)
+    {
+        const struct IndexTrigramRecord *tri = b->base->trigrams;
+        baseEnd = b->base->header->numTrigrams;
+        size_t lo = 0, hi = baseEnd;
+        while (lo < hi)
+        {
+            size_t mid = lo + (hi - lo) / 2;
+            if (tri[mid].trigram < range->lo) lo = mid + 1;
+            else hi = mid;
+        }
+        baseNext = lo;
+        while (baseEnd > baseNext && tri[baseEnd - 1].trigram >= range->hi) baseEnd--;
+    }
+
+    uint32_t *ids = NULL;
+    size_t numIds = 0, idsCap = 0;
+    while (!range->failed)
+    {
+        int best = -1;
+        for (int i = 0; i < numSources; i++)
+        {
+            if (sources[i].valid && (best < 0 || sources[i].head < sources[best].head)) best = i;
+        }
+        int haveBase = baseNext < baseEnd;
+        if (best < 0 && !haveBase) break;
+
+        uint32_t trigram = best >= 0 ? (uint32_t)(sources[best].head >> 32) : UINT32_MAX;
+        if (haveBase && b->base->trigrams[baseNext].trigram < trigram) trigram = b->base->trigrams[baseNext].trigram;
+
+        numIds = 0;
+        int needSort = 0;
+        if (haveBase && b->base->trigrams[baseNext].trigram == trigram)
+        {
+            const struct IndexTrigramRecord *rec = &b->base->trigrams[baseNext++];
+            uint32_t *old = decodePostings(b->base, rec);
+            for (uint32_t i = 0; i < rec->count; i++)
+            {
+                uint32_t newId = b->oldToNew[old[i]];
+                if (newId != UINT32_MAX) appendId(&ids, &numIds, &idsCap, newId);
+            }
+            free(old);
+            needSort = numIds > 0;
+        }
+        while (1)
+        {
+            best = -1;
+            for (int i = 0; i < numSources; i++)
+            {
+                if (sources[i].valid && (best < 0 || sources[i].head < sources[best].head)) best = i;
+            }
+            if (best < 0 || (uint32_t)(sources[best].head >> 32) != trigram) break;
+            appendId(&ids, &numIds, &idsCap, (uint32_t)sources[best].head);
+            sourceAdvance(&sources[best]);
+        }
+        if (numIds == 0) continue;
+        if (needSort) qsort(ids, numIds, sizeof(uint32_t), compareU32);
+
+        if (range->tableLen == range->tableCap)
+        {
+            range->tableCap = range->tableCap ? range->tableCap * 2 : 1024;
+            range->table = realloc(range->table, sizeof(struct IndexTrigramRecord) * range->tableCap);
+        }
+        struct IndexTrigramRecord *rec = &range->table[range->tableLen++];
+        rec->trigram = trigram;
+        rec->count = (uint32_t)numIds;
+        rec->offset = range->len;
+        for (size_t i = 0; i < numIds; i++)
+        {
+            appendVarint(range, i == 0 ? ids[0] : ids[i] - ids[i - 1]);
+        }
+    }
+
+    for (int i = 0; i < numSources; i++)
+    {
+        if (sources[i].fp) fclose(sources[i].fp);
+    }
+    free(sources);
+    free(ids);
+
+    pthread_mutex_lock(&b->mutex);
+    range->done = 1;
+    pthread_cond_broadcast(&b->rangeDone);
+    pthread_mutex_unlock(&b->mutex);
+}
+
+/* * 完成索引构建
+ * 1.对内存中剩余的对排序，写出文件表和路径字符串
+ * 2.按三字节组的首字节切成 INDEX_RANGES 段，每段在线程池中独立归并、编码
+ * 3.按顺序写出每段的倒排列表，回填三字节组表中的偏移，最后写出三字节组表和文件头；
+ *   先写到临时文件，成功后再 rename，避免留下写了一半的索引
+ *
+ * @param b 索引构建器，调用后被释放
+ * @param pool 线程池，为 NULL 时在当前线程中逐段完成
+ * @return 0 成功，-1 失败
+ */
+int indexBuilderFinish(struct IndexBuilder *b, struct ThreadPool *pool)
+{
+    int ret = -1;
+    char tmpPath[4096];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", b->indexPath);
+    FILE *fp = fopen(tmpPath, "wb");
+    struct compactRange *ranges = calloc(INDEX_RANGES, sizeof(struct compactRange));
+    int scheduled = 0;
+
+    do
+    {
+        if (fp == NULL || ranges == NULL) break;
+
+        struct IndexHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+        header.version = INDEX_VERSION;
+        header.numFiles = b->numFiles;
+        fwrite(&header, sizeof(header), 1, fp);
+
+        // 文件表和路径字符串
+        header.fileTableOffset = sizeof(header);
+        uint64_t pathOffset = 0;
+        for (uint32_t i = 0; i < b->numFiles; i++)
+        {
+            struct IndexFileRecord rec;
+            rec.pathOffset = pathOffset;
+            rec.ino = b->files[i].ino;
+            rec.size = b->files[i].size;
+            rec.mtimeNs = b->files[i].mtimeNs;
+            fwrite(&rec, sizeof(rec), 1, fp);
+            pathOffset += strlen(b->files[i].path) + 1;
+        }
+        header.pathsOffset = header.fileTableOffset + (uint64_t)b->numFiles * sizeof(struct IndexFileRecord);
+        for (uint32_t i = 0; i < b->numFiles; i++)
+        {
+            fwrite(b->files[i].path, 1, strlen(b->files[i].path) + 1, fp);
+        }
+        header.postingsOffset = header.pathsOffset + pathOffset;
+
+        // 分段归并
+        radixSort64(b->pairs, b->numPairs);
+        for (int i = 0; i < INDEX_RANGES; i++)
+        {
+            ranges[i].b = b;
+            ranges[i].lo = (uint32_t)i << 16;
+            ranges[i].hi = (uint32_t)(i + 1) << 16;
+            if (pool == NULL || ThreadPoolAdd(pool, compactRangeTask, &ranges[i]) != 0)
+            {
+                compactRangeTask(&ranges[i]);
+            }
+            scheduled++;
+        }
+
+        // 按顺序等待每一段完成并写出，写完即释放
+        uint64_t written = 0;
+        uint64_t numTrigrams = 0;
+        int failed = 0;
+        for (int i = 0; i < INDEX_RANGES; i++)
+        {
+            pthread_mutex_lock(&b->mutex);
+            while (!ranges[i].done) pthread_cond_wait(&b->rangeDone, &b->mutex);
+            pthread_mutex_unlock(&b->mutex);
+
+            failed |= ranges[i].failed;
+            fwrite(ranges[i].postings, 1, ranges[i].len, fp);
+            for (size_t t = 0; t < ranges[i].tableLen; t++) ranges[i].table[t].offset += written;
+            written += ranges[i].len;
+            numTrigrams += ranges[i].tableLen;
+            free(ranges[i].postings);
+            ranges[i].postings = NULL;
+        }
+        header.trigramTableOffset = header.postingsOffset + written;
+        header.numTrigrams = numTrigrams;
+        for (int i = 0; i < INDEX_RANGES; i++)
+        {
+            fwrite(ranges[i].table, sizeof(struct IndexTrigramRecord), ranges[i].tableLen, fp);
+        }
+        if (failed) break;
+
+        fseek(fp, 0, SEEK_SET);
+        fwrite(&header, sizeof(header), 1, fp);
+        if (ferror(fp)) break;
+        if (fclose(fp) != 0)
+        {
+            fp = NULL;
+            break;
+        }
+        fp = NULL;
+        if (rename(tmpPath, b->indexPath) != 0) break;
+        ret = 0;
+    } while (0);
+
+    // 出错提前退出时也要等已经交给线程池的段结束，它们还在使用 b
+    for (int i = 0; i < scheduled; i++)
+    {
+        pthread_mutex_lock(&b->mutex);
+        while (!ranges[i].done) pthread_cond_wait(&b->rangeDone, &b->mutex);
+        pthread_mutex_unlock(&b->mutex);
+    }
+
+    if (fp) fclose(fp);
+    if (ret != 0) unlink(tmpPath);
+    for (int i = 0; i < b->numRuns; i++)
+    {
+        char path[4096];
+        runPath(b, i, path, sizeof(path));
+        unlink(path);
+    }
+
+    if (ranges)
+    {
+        for (int i = 0; i < INDEX_RANGES; i++)
+        {
+            free(ranges[i].postings);
+            free(ranges[i].table);
+        }
+        free(ranges);
+    }
+    for (uint32_t i = 0; i < b->numFiles; i++) free(b->files[i].path);
+    free(b->files);
+    free(b->pairs);
+    free(b->baseOrder);
+    free(b->oldToNew);
+    free(b->indexPath);
+    pthread_cond_destroy(&b->rangeDone);
+    pthread_mutex_destroy(&b->mutex);
+    free(b);
+    return ret;
+}
+
+/* * 打开索引文件并 mmap 到内存，检查文件头和各区域的边界
+ *
+ * @param indexPath 索引文件路径
+ * @return 索引读取器，失败返回 NULL
+ */
+struct IndexReader *indexOpen(const char *indexPath)
+{
+    int fd = open(indexPath, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct IndexHeader))
+    {
+        close(fd);
+        return NULL;
+    }
+
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+
+    const struct IndexHeader *h = map;
+    uint64_t size = (uint64_t)st.st_size;
+    if (memcmp(h->magic, INDEX_MAGIC, sizeof(h->magic)) != 0 || h->version != INDEX_VERSION ||
+        h->fileTableOffset + h->numFiles * sizeof(struct IndexFileRecord) > size ||
+        h->pathsOffset > h->postingsOffset || h->postingsOffset > h->trigramTableOffset ||
+        h->trigramTableOffset + h->numTrigrams * sizeof(struct IndexTrigramRecord) > size)
+    {
+        munmap(map, (size_t)st.st_size);
+        return NULL;
+    }
+
+    struct IndexReader *r = calloc(1, sizeof(struct IndexReader));
+    r->map = map;
+    r->mapLen = (size_t)st.st_size;
+    r->header = h;
+    r->files = (const struct IndexFileRecord*)((const char*)map + h->fileTableOffset);
+    r->paths = (const char*)map + h->pathsOffset;
+    r->postings = (const unsigned char*)map + h->postingsOffset;
+    r->trigrams = (const struct IndexTrigramRecord*)((const char*)map + h->trigramTableOffset);
+    return r;
+}
+
+void indexClose(struct IndexReader *r)
+{
+    if (r == NULL) return;
+    munmap(r->map, r->mapLen);
+    free(r);
+}
+
+uint64_t indexNumFiles(const struct IndexReader *r)
+{
+    return r->header->numFiles;
+}
+
+const struct IndexFileRecord *indexFile(const struct IndexReader *r, uint64_t fileId)
+{
+    return &r->files[fileId];
+}
+
+const char *indexFilePath(const struct IndexReader *r, uint64_t fileId)
+{
+    return r->paths + r->files[fileId].pathOffset;
+}
+
+// 二分查找三字节组，不存在返回 NULL
+static const struct IndexTrigramRecord *findTrigram(const struct IndexReader *r, uint32_t trigram)
+{
+    size_t lo = 0, hi = r->header->numTrigrams;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (r->trigrams[mid].trigram < trigram) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo < r->header->numTrigrams && r->trigrams[lo].trigram == trigram) return &r->trigrams[lo];
+    return NULL;
+}
+
+// 解码一个三字节组的倒排列表
+static uint32_t *decodePostings(const struct IndexReader *r, const struct IndexTrigramRecord *rec)
+{
+    uint32_t *ids = malloc(sizeof(uint32_t) * (rec->count ? rec->count : 1));
+    const unsigned char *p = r->postings + rec->offset;
+    uint32_t prev = 0;
+    for (uint32_t i = 0; i < rec->count; i++)
+    {
+        uint64_t v = 0;
+        int shift = 0;
+        while (*p & 0x80)
+        {
+            v |= (uint64_t)(*p++ & 0x7f) << shift;
+            shift += 7;
+        }
+        v |= (uint64_t)*p++ << shift;
+        prev = i == 0 ? (uint32_t)v : prev + (uint32_t)v;
+        ids[i] = prev;
+    }
+    return ids;
+}
+
+static int compareRecordCount(const void *a, const void *b)
+{
+    uint32_t x = (*(const struct IndexTrigramRecord* const*)a)->count;
+    uint32_t y = (*(const struct IndexTrigramRecord* const*)b)->count;
+    return x < y ? -1 : x > y;
+}
+
+/* * 查询包含某个字符串的候选文件
+ * 取字符串的所有三字节组，从包含文件最少的开始依次求交集，结果在 candidates 中置 1
+ * 候选文件只是"可能包含"，还需要用真正的匹配器确认
+ *
+ * @param r 索引读取器
+ * @param literal 字符串
+ * @param len 字符串长度
+ * @param candidates 输出：长度为文件数的标记数组，调用者负责清零
+ * @return 1 已经按索引过滤，0 字符串太短无法过滤（调用者应把所有文件都当作候选）
+ */
+int indexQuery(const struct IndexReader *r, const char *literal, size_t len, unsigned char *candidates)
+{
+    if (len < 3) return 0;
+
+    uint32_t *trigrams = NULL;
+    size_t count = 0, cap = 0;
+    struct TrigramWindow w = {0, 0};
+    collectTrigrams(&w, literal, len, &trigrams, &count, &cap);
+    count = uniqueTrigrams(trigrams, count);
+
+    const struct IndexTrigramRecord **recs = malloc(sizeof(*recs) * count);
+    for (size_t i = 0; i < count; i++)
+    {
+        recs[i] = findTrigram(r, trigrams[i]);
+        if (recs[i] == NULL)
+        {
+            // 有一个三字节组没有出现在任何文件中，不可能有候选
+            free(recs);
+            free(trigrams);
+            return 1;
+        }
+    }
+    qsort(recs, count, sizeof(*recs), compareRecordCount);
+
+    uint32_t *result = decodePostings(r, recs[0]);
+    size_t resultLen = recs[0]->count;
+    for (size_t i = 1; i < count && resultLen > 0; i++)
+    {
+        uint32_t *other = decodePostings(r, recs[i]);
+        size_t a = 0, b = 0, n = 0;
+        while (a < resultLen && b < recs[i]->count)
+        {
+            if (result[a] < other[b]) a++;
+            else if (result[a] > other[b]) b++;
+            else
+            {
+                result[n++] = result[a];
+                a++;
+                b++;
+            }
+        }
+        resultLen = n;
+        free(other);
+    }
+
+    for (size_t i = 0; i < resultLen; i++)
+    {
+        if (result[i] < r->header->numFiles) candidates[result[i]] = 1;
+    }
+    free(result);
+    free(recs);
+    free(trigrams);
+    return 1;
+}
@@ -0,0 +1,79 @@
+//
+// Created by 吨吨 on 2026/10/19.
+//
+
+#ifndef TRIGRAM_H
+#define TRIGRAM_H
+#include <stddef.h>
+#include <stdint.h>
+
+// 三字节组（trigram）倒排索引
+// 索引文件布局：文件头 | 文件表 | 路径字符串 | 倒排列表 | 三字节组表
+// 三字节组统一按 ASCII 小写折叠后计算，查询时也先折叠，忽略大小写的查询可以直接复用同一个索引；
+// 倒排列表中的文件编号按差值做变长编码，查询时直接在 mmap 出来的文件上解码
+
+#define INDEX_MAGIC "PFINDIX1"
+#define INDEX_VERSION 1
+
+struct IndexHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t numFiles;
+    uint64_t numTrigrams;
+    uint64_t fileTableOffset;
+    uint64_t pathsOffset;
+    uint64_t postingsOffset;
+    uint64_t trigramTableOffset;
+};
+
+// 文件表中的一项，(ino, size, mtimeNs) 用于判断文件是否发生了变化
+struct IndexFileRecord
+{
+    uint64_t pathOffset; // 相对路径字符串区的偏移，字符串以 '\0' 结尾
+    uint64_t ino;
+    uint64_t size;
+    int64_t mtimeNs;
+};
+
+// 三字节组表中的一项，按 trigram 升序排列
+struct IndexTrigramRecord
+{
+    uint32_t trigram;
+    uint32_t count;  // 包含该三字节组的文件数
+    uint64_t offset; // 相对倒排列表区的偏移
+};
+
+// 跨块提取三字节组时保存前两个字节
+struct TrigramWindow
+{
+    uint32_t last; // 最近两个字节（已折叠）
+    int have;      // 已经有几个字节，最多为 2
+};
+
+struct IndexBuilder;
+struct IndexReader;
+struct ThreadPool;
+
+struct IndexBuilder *indexBuilderCreate(const char *indexPath);
+int indexBuilderSetBase(struct IndexBuilder *b, const struct IndexReader *base);
+uint32_t indexBuilderAddFile(struct IndexBuilder *b, const char *path);
+void indexBuilderSetFileInfo(struct IndexBuilder *b, uint32_t fileId, uint64_t ino, uint64_t size, int64_t mtimeNs);
+int indexBuilderReuseFile(struct IndexBuilder *b, uint32_t fileId);
+void indexBuilderAddTrigrams(struct IndexBuilder *b, uint32_t fileId, uint32_t *trigrams, size_t count);
+uint32_t indexBuilderReusedCount(struct IndexBuilder *b);
+uint32_t indexBuilderFileCount(struct IndexBuilder *b);
+int indexBuilderFinish(struct IndexBuilder *b, struct ThreadPool *pool);
+
+void collectTrigrams(struct TrigramWindow *w, const char *data, size_t len, uint32_t **out, size_t *count, size_t *cap);
+size_t uniqueTrigrams(uint32_t *trigrams, size_t count);
+
+struct IndexReader *indexOpen(const char *indexPath);
+void indexClose(struct IndexReader *r);
+uint64_t indexNumFiles(const struct IndexReader *r);
+const struct IndexFileRecord *indexFile(const struct IndexReader *r, uint64_t fileId);
+const char *indexFilePath(const struct IndexReader *r, uint64_t fileId);
+int indexQuery(const struct IndexReader *r, const char *literal, size_t len, unsigned char *candidates);
+
+#endif //TRIGRAM_H
@@ -0,0 +1,533 @@
+//
+// Created by 吨吨 on 2026/10/19.
+//
+#include "uring.h"
+#include <stdlib.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING 1
+#endif
+#endif
+
+#ifdef HAVE_IO_URING
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+// close 的完成事件不对应任何槽位
+#define CLOSE_TAG UINT64_MAX
+
+#define SLOT_OPEN 0
+#define SLOT_READ 1
+
+// 等待打开的文件
+struct IoItem
+{
+    const char *path; // 调用者保证在回调之前一直有效
+    void *arg;
+    struct IoItem *next;
+};
+
+// 正在打开或读取的文件，每个文件同一时刻只有一个操作在内核中
+struct IoSlot
+{
+    int state;
+    int fd;
+    const char *path;
+    void *arg;
+    struct IoPrefetch *pf;
+};
+
+struct IoRing
+{
+    int ringFd;
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned *sqMask;
+    unsigned *sqArray;
+    unsigned sqEntries;
+    struct io_uring_sqe *sqes;
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned *cqMask;
+    struct io_uring_cqe *cqes;
+    void *sqMap;
+    size_t sqMapSize;
+    void *cqMap;
+    size_t cqMapSize;
+    size_t sqesSize;
+    unsigned toSubmit;     // 已经填好还没提交的 SQE 个数
+
+    // 以下只在 I/O 线程中访问
+    struct IoSlot *slots;
+    unsigned *freeSlots;
+    unsigned numFreeSlots;
+    unsigned inflight;     // 内核中尚未完成的操作数，包括 close
+    unsigned closing;      // 其中 close 的个数
+
+    unsigned depth;
+    size_t bufSize;
+    IoReadyFunc ready;
+
+    // 以下由 mutex 保护
+    pthread_mutex_t mutex;
+    pthread_cond_t wake;     // 有新文件、有缓冲区归还或者要退出
+    pthread_cond_t notFull;  // 等待队列有空位
+    pthread_cond_t idle;     // 所有文件都已经交给回调
+    struct IoItem *head;
+    struct IoItem *tail;
+    unsigned backlog;        // 等待打开的文件数
+    unsigned long pending;   // 已提交但还没回调的文件数
+    struct IoPrefetch *bufs; // depth * 2 块缓冲区，交给回调后由调用者归还
+    unsigned *freeBufs;
+    unsigned numFreeBufs;
+    int shutdown;
+
+    pthread_t thread;
+};
+
+static int ringSetup(unsigned entries, struct io_uring_params *p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int ringEnter(struct IoRing *r, unsigned minComplete)
+{
+    while (1)
+    {
+        int ret = (int)syscall(__NR_io_uring_enter, r->ringFd, r->toSubmit, minComplete,
+                               minComplete ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        if (ret >= 0)
+        {
+            r->toSubmit -= (unsigned)ret;
+            return 0;
+        }
+        if (errno != EINTR) return -1;
+    }
+}
+
+/* * 检查内核是否支持需要的操作（openat、read、close 都是 5.6 加入的）
+ *
+ * @param fd io_uring 文件描述符
+ * @return 1 全部支持，0 不支持或者内核太旧不能探测
+ */
+static int probeOps(int fd)
+{
+    const int ops[] = {IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_CLOSE};
+    size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = calloc(1, size);
+    if (probe == NULL) return 0;
+    int ok = syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) == 0;
+    for (size_t i = 0; ok && i < sizeof(ops) / sizeof(ops[0]); i++)
+    {
+        ok = ops[i] <= probe->last_op && (probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED);
+    }
+    free(probe);
+    return ok;
+}
+
+/* * 映射提交队列和完成队列
+ *
+ * @param r 环
+ * @param p io_uring_setup 返回的参数
+ * @return 0 成功，-1 失败
+ */
+static int mapRings(struct IoRing *r, const struct io_uring_params *p)
+{
+    r->sqMapSize = p->sq_off.array + p->sq_entries * sizeof(unsigned);
+    r->cqMapSize = p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+    int single = (p->features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single)
+    {
+        if (r->cqMapSize > r->sqMapSize) r->sqMapSize = r->cqMapSize;
+        r->cqMapSize = 0;
+    }
+
+    r->sqMap = mmap(NULL, r->sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    r->ringFd, IORING_OFF_SQ_RING);
+    if (r->sqMap == MAP_FAILED) return -1;
+    r->cqMap = r->sqMap;
+    if (!single)
+    {
+        r->cqMap = mmap(NULL, r->cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        r->ringFd, IORING_OFF_CQ_RING);
+        if (r->cqMap == MAP_FAILED) return -1;
+    }
+    r->sqesSize = p->sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = mmap(NULL, r->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   r->ringFd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) return -1;
+
+    char *sq = r->sqMap;
+    char *cq = r->cqMap;
+    r->sqHead = (unsigned*)(sq + p->sq_off.head);
+    r->sqTail = (unsigned*)(sq + p->sq_off.tail);
+    r->sqMask = (unsigned*)(sq + p->sq_off.ring_mask);
+    r->sqArray = (unsigned*)(sq + p->sq_off.array);
+    r->sqEntries = p->sq_entries;
+    r->cqHead = (unsigned*)(cq + p->cq_off.head);
+    r->cqTail = (unsigned*)(cq + p->cq_off.tail);
+    r->cqMask = (unsigned*)(cq + p->cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe*)(cq + p->cq_off.cqes);
+    return 0;
+}
+
+// 取一个空闲的 SQE；内核中的操作数不会超过队列长度，所以总能取到
+static struct io_uring_sqe *getSqe(struct IoRing *r)
+{
+    unsigned tail = *r->sqTail;
+    unsigned idx = tail & *r->sqMask;
+    struct io_uring_sqe *sqe = &r->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    r->sqArray[idx] = idx;
+    __atomic_store_n(r->sqTail, tail + 1, __ATOMIC_RELEASE);
+    r->toSubmit++;
+    r->inflight++;
+    return sqe;
+}
+
+static void prepOpen(struct IoRing *r, unsigned slot)
+{
+    struct io_uring_sqe *sqe = getSqe(r);
+    sqe->opcode = IORING_OP_OPENAT;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = (uint64_t)(uintptr_t)r->slots[slot].path;
+    sqe->open_flags = O_RDONLY | O_CLOEXEC;
+    sqe->user_data = slot;
+    r->slots[slot].state = SLOT_OPEN;
+}
+
+static void prepRead(struct IoRing *r, unsigned slot)
+{
+    struct io_uring_sqe *sqe = getSqe(r);
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = r->slots[slot].fd;
+    sqe->addr = (uint64_t)(uintptr_t)r->slots[slot].pf->buf;
+    sqe->len = (unsigned)r->bufSize;
+    sqe->off = 0;
+    sqe->user_data = slot;
+    r->slots[slot].state = SLOT_READ;
+}
+
+// 关闭操作也批量提交；积压太多时直接同步关闭，保证内核中的操作数不超过队列长度
+static void prepClose(struct IoRing *r, int fd)
+{
+    if (r->closing >= r->depth)
+    {
+        close(fd);
+        return;
+    }
+    struct io_uring_sqe *sqe = getSqe(r);
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->fd = fd;
+    sqe->user_data = CLOSE_TAG;
+    r->closing++;
+}
+
+/* * 一个文件的第一块已经读完（或失败），交给回调，归还槽位
+ *
+ * @param r 环
+ * @param slot 槽位
+ */
+static void finishSlot(struct IoRing *r, unsigned slot)
+{
+    struct IoSlot *s = &r->slots[slot];
+    r->ready(s->arg, s->pf);
+    r->freeSlots[r->numFreeSlots++] = slot;
+
+    pthread_mutex_lock(&r->mutex);
+    if (--r->pending == 0) pthread_cond_broadcast(&r->idle);
+    pthread_mutex_unlock(&r->mutex);
+}
+
+static void handleCompletion(struct IoRing *r, uint64_t userData, int res)
+{
+    r->inflight--;
+    if (userData == CLOSE_TAG)
+    {
+        r->closing--;
+        return;
+    }
+
+    unsigned slot = (unsigned)userData;
+    struct IoSlot *s = &r->slots[slot];
+    struct IoPrefetch *pf = s->pf;
+    if (s->state == SLOT_OPEN)
+    {
+        if (res < 0)
+        {
+            pf->err = -res;
+            finishSlot(r, slot);
+            return;
+        }
+        s->fd = res;
+        prepRead(r, slot);
+        return;
+    }
+
+    if (res < 0)
+    {
+        pf->err = -res;
+        prepClose(r, s->fd);
+    }
+    else
+    {
+        pf->len = (size_t)res;
+        // 第一块没有读满说明已经到了文件末尾，不必再让调用者去关闭
+        if (pf->len < r->bufSize)
+        {
+            prepClose(r, s->fd);
+        }
+        else
+        {
+            pf->fd = s->fd;
+        }
+    }
+    finishSlot(r, slot);
+}
+
+static void *ioThread(void *arg)
+{
+    struct IoRing *r = arg;
+    while (1)
+    {
+        pthread_mutex_lock(&r->mutex);
+        while (r->inflight == 0 && !r->shutdown &&
+               (r->head == NULL || r->numFreeSlots == 0 || r->numFreeBufs == 0))
+        {
+            pthread_cond_wait(&r->wake, &r->mutex);
+        }
+        if (r->inflight == 0 && r->shutdown && r->head == NULL)
+        {
+            pthread_mutex_unlock(&r->mutex);
+            break;
+        }
+
+        // 有空闲的槽位和缓冲区就开始打开下一个文件
+        int taken = 0;
+        while (r->head != NULL && r->numFreeSlots > 0 && r->numFreeBufs > 0)
+        {
+            struct IoItem *item = r->head;
+            r->head = item->next;
+            if (r->head == NULL) r->tail = NULL;
+            r->backlog--;
+            taken = 1;
+
+            unsigned slot = r->freeSlots[--r->numFreeSlots];
+            struct IoPrefetch *pf = &r->bufs[r->freeBufs[--r->numFreeBufs]];
+            pf->len = 0;
+            pf->fd = -1;
+            pf->err = 0;
+            r->slots[slot].path = item->path;
+            r->slots[slot].arg = item->arg;
+            r->slots[slot].pf = pf;
+            r->slots[slot].fd = -1;
+            prepOpen(r, slot);
+            free(item);
+        }
+        if (taken) pthread_cond_broadcast(&r->notFull);
+        pthread_mutex_unlock(&r->mutex);
+
+        if (ringEnter(r, r->inflight > 0 ? 1 : 0) != 0) break;
+
+        unsigned head = *r->cqHead;
+        unsigned tail = __atomic_load_n(r->cqTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++)
+        {
+            const struct io_uring_cqe *cqe = &r->cqes[head & *r->cqMask];
+            uint64_t userData = cqe->user_data;
+            int res = cqe->res;
+            __atomic_store_n(r->cqHead, head + 1, __ATOMIC_RELEASE);
+            handleCompletion(r, userData, res);
+        }
+    }
+    return NULL;
+}
+
+static void freeRing(struct IoRing *r)
+{
+    if (r->sqes != NULL && r->sqes != MAP_FAILED) munmap(r->sqes, r->sqesSize);
+    if (r->cqMap != NULL && r->cqMap != MAP_FAILED && r->cqMap != r->sqMap) munmap(r->cqMap, r->cqMapSize);
+    if (r->sqMap != NULL && r->sqMap != MAP_FAILED) munmap(r->sqMap, r->sqMapSize);
+    if (r->ringFd >= 0) close(r->ringFd);
+    if (r->bufs != NULL)
+    {
+        for (unsigned i = 0; i < r->depth * 2; i++) free(r->bufs[i].buf);
+    }
+    free(r->bufs);
+    free(r->freeBufs);
+    free(r->slots);
+    free(r->freeSlots);
+    free(r);
+}
+
+/* * 创建 io_uring 和 I/O 线程
+ *
+ * @param depth 同时在读的文件数
+ * @param bufSize 每个文件预读的字节数
+ * @param ready 第一块读完时的回调，在 I/O 线程中调用
+ * @return 成功返回环，内核不支持 io_uring 或者被禁用时返回 NULL，调用者应当退回普通的读取方式
+ */
+struct IoRing *ioRingCreate(unsigned depth, size_t bufSize, IoReadyFunc ready)
+{
+    struct IoRing *r = calloc(1, sizeof(struct IoRing));
+    if (r == NULL) return NULL;
+    r->ringFd = -1;
+    r->depth = depth;
+    r->bufSize = bufSize;
+    r->ready = ready;
+
+    // 打开/读取最多 depth 个，关闭最多 depth 个
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    r->ringFd = ringSetup(depth * 2, &p);
+    if (r->ringFd < 0 || !probeOps(r->ringFd) || mapRings(r, &p) != 0)
+    {
+        freeRing(r);
+        return NULL;
+    }
+
+    r->slots = calloc(depth, sizeof(struct IoSlot));
+    r->freeSlots = malloc(sizeof(unsigned) * depth);
+    r->bufs = calloc(depth * 2, sizeof(struct IoPrefetch));
+    r->freeBufs = malloc(sizeof(unsigned) * depth * 2);
+    if (r->slots == NULL || r->freeSlots == NULL || r->bufs == NULL || r->freeBufs == NULL)
+    {
+        freeRing(r);
+        return NULL;
+    }
+    for (unsigned i = 0; i < depth; i++) r->freeSlots[r->numFreeSlots++] = depth - 1 - i;
+    for (unsigned i = 0; i < depth * 2; i++)
+    {
+        r->bufs[i].buf = malloc(bufSize);
+        if (r->bufs[i].buf == NULL)
+        {
+            freeRing(r);
+            return NULL;
+        }
+        r->freeBufs[r->numFreeBufs++] = depth * 2 - 1 - i;
+    }
+
+    pthread_mutex_init(&r->mutex, NULL);
+    pthread_cond_init(&r->wake, NULL);
+    pthread_cond_init(&r->notFull, NULL);
+    pthread_cond_init(&r->idle, NULL);
+    if (pthread_create(&r->thread, NULL, ioThread, r) != 0)
+    {
+        pthread_mutex_destroy(&r->mutex);
+        pthread_cond_destroy(&r->wake);
+        pthread_cond_destroy(&r->notFull);
+        pthread_cond_destroy(&r->idle);
+        freeRing(r);
+        return NULL;
+    }
+    return r;
+}
+
+/* * 提交一个文件，等待打开的文件太多时阻塞
+ *
+ * @param r 环
+ * @param path 文件路径，在回调之前必须一直有效
+ * @param arg 原样传给回调
+ * @return 0 成功，-1 内存不足
+ */
+int ioRingSubmit(struct IoRing *r, const char *path, void *arg)
+{
+    struct IoItem *item = malloc(sizeof(struct IoItem));
+    if (item == NULL) return -1;
+    item->path = path;
+    item->arg = arg;
+    item->next = NULL;
+
+    pthread_mutex_lock(&r->mutex);
+    while (r->backlog >= r->depth * 16)
+    {
+        pthread_cond_wait(&r->notFull, &r->mutex);
+    }
+    if (r->tail) r->tail->next = item;
+    else r->head = item;
+    r->tail = item;
+    r->backlog++;
+    r->pending++;
+    pthread_cond_signal(&r->wake);
+    pthread_mutex_unlock(&r->mutex);
+    return 0;
+}
+
+/* * 归还预读缓冲区，文件还开着时一并关闭
+ *
+ * @param r 环
+ * @param pf 回调拿到的预读结果
+ */
+void ioRingRelease(struct IoRing *r, struct IoPrefetch *pf)
+{
+    if (pf->fd >= 0)
+    {
+        close(pf->fd);
+        pf->fd = -1;
+    }
+    pthread_mutex_lock(&r->mutex);
+    r->freeBufs[r->numFreeBufs++] = (unsigned)(pf - r->bufs);
+    pthread_cond_signal(&r->wake);
+    pthread_mutex_unlock(&r->mutex);
+}
+
+// 等待所有已提交的文件都交给回调
+void ioRingWait(struct IoRing *r)
+{
+    pthread_mutex_lock(&r->mutex);
+    while (r->pending > 0)
+    {
+        pthread_cond_wait(&r->idle, &r->mutex);
+    }
+    pthread_mutex_unlock(&r->mutex);
+}
+
+// 等待剩下的操作完成，结束 I/O 线程并释放所有资源；调用前所有预读缓冲区都应当已经归还
+void ioRingDestroy(struct IoRing *r)
+{
+    if (r == NULL) return;
+    pthread_mutex_lock(&r->mutex);
+    r->shutdown = 1;
+    pthread_cond_signal(&r->wake);
+    pthread_mutex_unlock(&r->mutex);
+    pthread_join(r->thread, NULL);
+
+    pthread_mutex_destroy(&r->mutex);
+    pthread_cond_destroy(&r->wake);
+    pthread_cond_destroy(&r->notFull);
+    pthread_cond_destroy(&r->idle);
+    freeRing(r);
+}
+
+#else
+// 没有 io_uring 的平台：总是创建失败，调用者使用普通的读取方式
+struct IoRing *ioRingCreate(unsigned depth, size_t bufSize, IoReadyFunc ready)
+{
+    return NULL;
+}
+
+int ioRingSubmit(struct IoRing *r, const char *path, void *arg)
+{
+    return -1;
+}
+
+void ioRingRelease(struct IoRing *r, struct IoPrefetch *pf)
+{
+}
+
+void ioRingWait(struct IoRing *r)
+{
+}
+
+void ioRingDestroy(struct IoRing *r)
+{
+}
+#endif
@@ -0,0 +1,32 @@
+//
+// Created by 吨吨 on 2026/10/19.
+//
+
+#ifndef URING_H
+#define URING_H
+#include <stddef.h>
+
+// 基于 io_uring 的异步预读
+// 一个专门的 I/O 线程批量提交 openat / read / close，每个文件读出第一块后通过回调交给调用者，
+// 同时在读的文件数（I/O 深度）由 depth 决定，和工作线程数无关
+// 文件在第一块内读完时 I/O 线程顺便提交 close，fd 为 -1；否则 fd 保持打开，由拿到结果的一方继续读取并关闭
+struct IoPrefetch
+{
+    char *buf;  // 第一块数据，用完后调用 ioRingRelease 归还
+    size_t len;
+    int fd;     // 文件还没读完时的描述符，否则为 -1
+    int err;    // 打开或读取失败时的 errno，此时 len 为 0
+};
+
+struct IoRing;
+
+// 文件的第一块读完（或失败）时在 I/O 线程中调用
+typedef void (*IoReadyFunc)(void *arg, struct IoPrefetch *pf);
+
+struct IoRing *ioRingCreate(unsigned depth, size_t bufSize, IoReadyFunc ready);
+int ioRingSubmit(struct IoRing *r, const char *path, void *arg);
+void ioRingRelease(struct IoRing *r, struct IoPrefetch *pf);
+void ioRingWait(struct IoRing *r);
+void ioRingDestroy(struct IoRing *r);
+
+#endif //URING_H
@@ -0,0 +1,154 @@
+//
+// Created by 吨吨 on 2026/10/19.
+//
+#include "visited.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define VISITED_EMPTY 0
+#define VISITED_BUSY 1  // 已经被抢占，dev 和 ino 还没写完
+#define VISITED_READY 2
+
+#define SHARD_INIT_CAP 256
+
+// 64 位整数的混合函数（splitmix64 的收尾部分）
+static uint64_t mix64(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+struct VisitedSet *visitedCreate(void)
+{
+    struct VisitedSet *set = calloc(1, sizeof(struct VisitedSet));
+    if (set == NULL) return NULL;
+    for (int i = 0; i < VISITED_SHARDS; i++)
+    {
+        struct VisitedShard *sh = &set->shards[i];
+        sh->entries = calloc(SHARD_INIT_CAP, sizeof(struct VisitedEntry));
+        sh->cap = SHARD_INIT_CAP;
+        pthread_rwlock_init(&sh->lock, NULL);
+        if (sh->entries == NULL)
+        {
+            visitedFree(set);
+            return NULL;
+        }
+    }
+    return set;
+}
+
+void visitedFree(struct VisitedSet *set)
+{
+    if (set == NULL) return;
+    for (int i = 0; i < VISITED_SHARDS; i++)
+    {
+        free(set->shards[i].entries);
+        pthread_rwlock_destroy(&set->shards[i].lock);
+    }
+    free(set);
+}
+
+// 清空集合，调用时不能有其他线程在插入
+void visitedClear(struct VisitedSet *set)
+{
+    for (int i = 0; i < VISITED_SHARDS; i++)
+    {
+        struct VisitedShard *sh = &set->shards[i];
+        memset(sh->entries, 0, sizeof(struct VisitedEntry) * sh->cap);
+        atomic_store_explicit(&sh->count, 0, memory_order_relaxed);
+    }
+}
+
+/* * 在一个分片中查找或插入，调用者持有分片的读锁（扩容时持有写锁）
+ *
+ * @param sh 分片
+ * @param h 哈希值
+ * @return 1 新插入，0 已经存在，-1 表已满
+ */
+static int shardInsert(struct VisitedShard *sh, uint64_t h, uint64_t dev, uint64_t ino)
+{
+    size_t mask = sh->cap - 1;
+    size_t i = (size_t)h & mask;
+    for (size_t n = 0; n < sh->cap; n++, i = (i + 1) & mask)
+    {
+        struct VisitedEntry *e = &sh->entries[i];
+        unsigned state = atomic_load_explicit(&e->state, memory_order_acquire);
+        if (state == VISITED_EMPTY)
+        {
+            if (atomic_compare_exchange_strong_explicit(&e->state, &state, VISITED_BUSY,
+                                                        memory_order_acq_rel, memory_order_acquire))
+            {
+                e->dev = dev;
+                e->ino = ino;
+                atomic_store_explicit(&e->state, VISITED_READY, memory_order_release);
+                atomic_fetch_add_explicit(&sh->count, 1, memory_order_relaxed);
+                return 1;
+            }
+        }
+        // 别的线程刚抢到这个槽，等它写完再比较
+        while (state == VISITED_BUSY)
+        {
+            state = atomic_load_explicit(&e->state, memory_order_acquire);
+        }
+        if (e->dev == dev && e->ino == ino) return 0;
+    }
+    return -1;
+}
+
+// 把分片扩容到两倍，调用者持有写锁
+static void shardGrow(struct VisitedShard *sh)
+{
+    struct VisitedEntry *old = sh->entries;
+    size_t oldCap = sh->cap;
+    struct VisitedEntry *entries = calloc(oldCap * 2, sizeof(struct VisitedEntry));
+    if (entries == NULL) return;
+
+    sh->entries = entries;
+    sh->cap = oldCap * 2;
+    atomic_store_explicit(&sh->count, 0, memory_order_relaxed);
+    for (size_t i = 0; i < oldCap; i++)
+    {
+        if (atomic_load_explicit(&old[i].state, memory_order_relaxed) != VISITED_READY) continue;
+        uint64_t h = mix64(old[i].dev * 0x9e3779b97f4a7c15ULL ^ old[i].ino);
+        shardInsert(sh, h, old[i].dev, old[i].ino);
+    }
+    free(old);
+}
+
+/* * 记录一个 (dev, ino)
+ *
+ * @param set 集合
+ * @param dev 设备号
+ * @param ino inode 号
+ * @return 1 第一次出现，0 已经访问过
+ */
+int visitedInsert(struct VisitedSet *set, uint64_t dev, uint64_t ino)
+{
+    uint64_t h = mix64(dev * 0x9e3779b97f4a7c15ULL ^ ino);
+    // 高位选分片，低位在分片内定位，两者互不相关
+    struct VisitedShard *sh = &set->shards[h >> 58];
+    while (1)
+    {
+        pthread_rwlock_rdlock(&sh->lock);
+        int ret = shardInsert(sh, h, dev, ino);
+        int crowded = atomic_load_explicit(&sh->count, memory_order_relaxed) * 4 > sh->cap * 3;
+        size_t cap = sh->cap;
+        pthread_rwlock_unlock(&sh->lock);
+
+        // 装载率超过 3/4 时扩容；其他线程可能已经扩过了，所以拿到写锁后再比较一次容量
+        if (ret == -1 || crowded)
+        {
+            pthread_rwlock_wrlock(&sh->lock);
+            if (sh->cap == cap) shardGrow(sh);
+            int grown = sh->cap != cap;
+            pthread_rwlock_unlock(&sh->lock);
+            // 内存不足无法扩容时当作第一次出现，最多是重复搜索
+            if (ret == -1 && !grown) return 1;
+        }
+        if (ret != -1) return ret;
+    }
+}
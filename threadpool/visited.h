@@ -0,0 +1,42 @@
+//
+// Created by 吨吨 on 2026/10/19.
+//
+
+#ifndef VISITED_H
+#define VISITED_H
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// 记录已经访问过的 (dev, ino)，多个线程可以同时插入
+// 按哈希值分成 VISITED_SHARDS 个分片，每个分片是一张开放寻址的表：
+// 插入时用 CAS 抢占空槽，不需要加锁；只有表需要扩容时才以写者身份独占这个分片
+#define VISITED_SHARDS 64
+
+struct VisitedEntry
+{
+    atomic_uint state; // VISITED_EMPTY / VISITED_BUSY / VISITED_READY
+    uint64_t dev;
+    uint64_t ino;
+};
+
+struct VisitedShard
+{
+    pthread_rwlock_t lock;   // 插入持有读锁，扩容持有写锁
+    struct VisitedEntry *entries;
+    size_t cap;              // 2 的幂
+    atomic_size_t count;
+};
+
+struct VisitedSet
+{
+    struct VisitedShard shards[VISITED_SHARDS];
+};
+
+struct VisitedSet *visitedCreate(void);
+void visitedFree(struct VisitedSet *set);
+void visitedClear(struct VisitedSet *set);
+int visitedInsert(struct VisitedSet *set, uint64_t dev, uint64_t ino);
+
+#endif //VISITED_H